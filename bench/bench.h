@@ -0,0 +1,38 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+#define BENCH_TICK_UNIT "cycle"
+
+/**
+ * Read the timestamp counter. On the CPUs we care about this ticks at the
+ * nominal frequency, which is close enough to core cycles for comparing two
+ * functions side-by-side.
+ */
+static inline uint64_t bench_ticks(void) { return __rdtsc(); }
+#else
+#define BENCH_TICK_UNIT "ns"
+
+static inline uint64_t bench_ticks(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/**
+ * Results of benchmarked calls are folded into this so the compiler cannot
+ * discard the work being measured.
+ */
+extern volatile uint64_t bench_sink;
+
+void run_hash_bench(void);
+void run_table_bench(void);
+void run_concurrent_bench(void);
+
+#endif /* BENCH_H */
@@ -0,0 +1,205 @@
+// sysconf is only declared by POSIX.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "libhash.h"
+
+// Large enough that threads rarely touch the same keys, small enough to stay
+// mostly cache resident.
+#define CONCURRENT_BENCH_KEYS (1u << 14)
+#define CONCURRENT_BENCH_OPS (1u << 19)
+#define CONCURRENT_BENCH_MAX_THREADS 64
+
+// One op in this many is an insert (of an existing key); the rest are gets.
+#define CONCURRENT_BENCH_WRITE_RATIO 16
+
+// Each measurement is the best of this many runs, to discount interference.
+#define CONCURRENT_BENCH_REPEATS 3
+
+// How often lock-free readers announce a quiescent state, in ops.
+#define CONCURRENT_BENCH_QUIESCE 64
+
+typedef enum {
+  BENCH_GLOBAL_MUTEX,
+  BENCH_STRIPED,
+  BENCH_SHARDED,
+  BENCH_LOCK_FREE
+} concurrent_kind;
+
+typedef struct {
+  concurrent_kind kind;
+  hash_table *ht;
+  pthread_mutex_t *mutex;
+  ct_table *ct;
+  sh_table *sh;
+  lf_table *lf;
+  char **keys;
+  uint64_t seed;
+  uint64_t sink;
+} concurrent_worker;
+
+static double wall_seconds(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void *concurrent_run(void *arg) {
+  concurrent_worker *w = arg;
+  uint64_t x = w->seed;
+  lf_thread *self =
+      w->kind == BENCH_LOCK_FREE ? lf_thread_register(w->lf) : NULL;
+
+  for (unsigned int i = 0; i < CONCURRENT_BENCH_OPS; i++) {
+    // xorshift64, so picking keys costs next to nothing.
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    const char *key = w->keys[x % CONCURRENT_BENCH_KEYS];
+    const bool write = (x >> 32) % CONCURRENT_BENCH_WRITE_RATIO == 0;
+
+    if (w->kind == BENCH_GLOBAL_MUTEX) {
+      pthread_mutex_lock(w->mutex);
+      if (write) {
+        ht_insert(w->ht, key, w);
+      } else {
+        w->sink += (uintptr_t)ht_get(w->ht, key);
+      }
+      pthread_mutex_unlock(w->mutex);
+    } else if (w->kind == BENCH_STRIPED) {
+      if (write) {
+        ct_insert(w->ct, key, w);
+      } else {
+        w->sink += (uintptr_t)ct_get(w->ct, key);
+      }
+    } else if (w->kind == BENCH_SHARDED) {
+      if (write) {
+        sh_insert(w->sh, key, w);
+      } else {
+        w->sink += (uintptr_t)sh_get(w->sh, key);
+      }
+    } else {
+      if (write) {
+        lf_insert(w->lf, key, w);
+      } else {
+        w->sink += (uintptr_t)lf_get(w->lf, key);
+      }
+
+      if (i % CONCURRENT_BENCH_QUIESCE == 0) {
+        lf_quiescent(self);
+      }
+    }
+  }
+
+  if (self != NULL) {
+    lf_thread_unregister(self);
+  }
+
+  return NULL;
+}
+
+/**
+ * Millions of ops per second across `threads` threads sharing one table: a
+ * hash_table behind a single mutex, as callers had to before, a ct_table, an
+ * sh_table or an lf_table.
+ */
+static double bench_concurrent(const concurrent_kind kind,
+                               const unsigned int threads, char **keys) {
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  hash_table *ht = ht_init(CONCURRENT_BENCH_KEYS * 2, NULL);
+  ct_table *ct = ct_init(CONCURRENT_BENCH_KEYS * 2, NULL);
+  sh_table *sh = sh_init(CONCURRENT_BENCH_KEYS * 2, NULL);
+  lf_table *lf = lf_init(CONCURRENT_BENCH_KEYS * 2, NULL);
+  for (unsigned int i = 0; i < CONCURRENT_BENCH_KEYS; i++) {
+    ht_insert(ht, keys[i], NULL);
+    ct_insert(ct, keys[i], NULL);
+    sh_insert(sh, keys[i], NULL);
+    lf_insert(lf, keys[i], NULL);
+  }
+
+  pthread_t tids[CONCURRENT_BENCH_MAX_THREADS];
+  concurrent_worker workers[CONCURRENT_BENCH_MAX_THREADS];
+
+  double best = 0;
+  for (unsigned int n = 0; n < CONCURRENT_BENCH_REPEATS; n++) {
+    const double start = wall_seconds();
+    for (unsigned int t = 0; t < threads; t++) {
+      workers[t] = (concurrent_worker){.kind = kind,
+                                       .ht = ht,
+                                       .mutex = &mutex,
+                                       .ct = ct,
+                                       .sh = sh,
+                                       .lf = lf,
+                                       .keys = keys,
+                                       .seed = (t + 1) * 0x9e3779b97f4a7c15ull};
+      pthread_create(&tids[t], NULL, concurrent_run, &workers[t]);
+    }
+    for (unsigned int t = 0; t < threads; t++) {
+      pthread_join(tids[t], NULL);
+      bench_sink += workers[t].sink;
+    }
+
+    const double mops = (double)threads * CONCURRENT_BENCH_OPS /
+                        (wall_seconds() - start) / 1e6;
+    if (mops > best) {
+      best = mops;
+    }
+  }
+
+  ht_delete_table(ht);
+  ct_delete_table(ct);
+  sh_delete_table(sh);
+  lf_delete_table(lf);
+  return best;
+}
+
+void run_concurrent_bench(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus < 1) {
+    cpus = 1;
+  }
+  if (cpus > CONCURRENT_BENCH_MAX_THREADS) {
+    cpus = CONCURRENT_BENCH_MAX_THREADS;
+  }
+
+  char **keys = malloc(CONCURRENT_BENCH_KEYS * sizeof(char *));
+  for (unsigned int i = 0; i < CONCURRENT_BENCH_KEYS; i++) {
+    keys[i] = malloc(16);
+    snprintf(keys[i], 16, "key-%u", i);
+  }
+
+  printf("\nconcurrent: Mops/s, %u keys, 1 in %u ops an insert, %ld cpus "
+         "(higher is better)\n",
+         CONCURRENT_BENCH_KEYS, CONCURRENT_BENCH_WRITE_RATIO, cpus);
+  printf("%12s %10s %10s %10s %10s %10s\n", "threads", "mutex", "striped",
+         "sharded", "lock-free", "speedup");
+
+  for (unsigned int threads = 1;; threads *= 2) {
+    if (threads > (unsigned int)cpus) {
+      threads = (unsigned int)cpus;
+    }
+
+    const double mutex = bench_concurrent(BENCH_GLOBAL_MUTEX, threads, keys);
+    const double striped = bench_concurrent(BENCH_STRIPED, threads, keys);
+    const double sharded = bench_concurrent(BENCH_SHARDED, threads, keys);
+    const double lock_free = bench_concurrent(BENCH_LOCK_FREE, threads, keys);
+    printf("%12u %10.2f %10.2f %10.2f %10.2f %9.1fx\n", threads, mutex,
+           striped, sharded, lock_free, lock_free / mutex);
+
+    if (threads == (unsigned int)cpus) {
+      break;
+    }
+  }
+
+  for (unsigned int i = 0; i < CONCURRENT_BENCH_KEYS; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+}
@@ -0,0 +1,69 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "hash.h"
+
+static const size_t key_lengths[] = {4, 8, 16, 32, 64, 256, 1024};
+
+/**
+ * The string hash `h_compute_hash` used before `h_hash`, kept here as the
+ * baseline: one `pow` call and one `%` per byte.
+ */
+static unsigned int legacy_h_hash(const char *key, const int prime,
+                                  const int capacity) {
+  long hash = 0;
+
+  const size_t len_s = strlen(key);
+  for (unsigned int i = 0; i < len_s; i++) {
+    hash += (long)pow(prime, len_s - (i + 1)) * key[i];
+    hash = hash % capacity;
+  }
+
+  return (unsigned int)hash;
+}
+
+static double bench_legacy(char *buf, size_t len, unsigned int iters) {
+  const uint64_t start = bench_ticks();
+  for (unsigned int i = 0; i < iters; i++) {
+    buf[0] = (char)('a' + (i & 15));
+    bench_sink += legacy_h_hash(buf, 157, 53);
+  }
+
+  return (double)(len * iters) / (double)(bench_ticks() - start);
+}
+
+static double bench_h_hash(char *buf, size_t len, unsigned int iters) {
+  const uint64_t start = bench_ticks();
+  for (unsigned int i = 0; i < iters; i++) {
+    buf[0] = (char)('a' + (i & 15));
+    bench_sink += h_hash(buf, len);
+  }
+
+  return (double)(len * iters) / (double)(bench_ticks() - start);
+}
+
+void run_hash_bench(void) {
+  printf("hash: bytes/%s (higher is better)\n", BENCH_TICK_UNIT);
+  printf("%8s %12s %12s %10s\n", "len", "legacy", "h_hash", "speedup");
+
+  for (size_t i = 0; i < sizeof(key_lengths) / sizeof(key_lengths[0]); i++) {
+    const size_t len = key_lengths[i];
+
+    char *buf = malloc(len + 1);
+    for (size_t j = 0; j < len; j++) {
+      buf[j] = (char)('a' + rand() % 26);
+    }
+    buf[len] = '\0';
+
+    // Scale the iteration counts so each run hashes a similar number of bytes;
+    // the legacy function is slow enough that it gets a smaller budget.
+    const double legacy = bench_legacy(buf, len, (1u << 22) / len);
+    const double fast = bench_h_hash(buf, len, (1u << 28) / len);
+
+    printf("%8zu %12.3f %12.3f %9.1fx\n", len, legacy, fast, fast / legacy);
+    free(buf);
+  }
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+#include "bench.h"
+
+volatile uint64_t bench_sink;
+
+int main(void) {
+  run_hash_bench();
+  run_table_bench();
+  run_concurrent_bench();
+
+  return 0;
+}
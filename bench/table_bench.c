@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "hash.h"
+#include "libhash.h"
+
+// Small enough that the table stays cache resident, so lookups are bound by
+// the probe arithmetic rather than by memory latency.
+#define TABLE_BENCH_KEYS (1u << 12)
+#define TABLE_BENCH_ROUNDS 256
+
+// Each measurement is the best of this many runs, to discount interference.
+#define TABLE_BENCH_REPEATS 5
+
+static uint64_t bench_min(const uint64_t a, const uint64_t b) {
+  return a < b ? a : b;
+}
+
+static char **make_keys(unsigned int n) {
+  char **keys = malloc(n * sizeof(char *));
+  for (unsigned int i = 0; i < n; i++) {
+    keys[i] = malloc(16);
+    snprintf(keys[i], 16, "key-%u", i);
+  }
+
+  return keys;
+}
+
+static void free_keys(char **keys, unsigned int n) {
+  for (unsigned int i = 0; i < n; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+}
+
+/**
+ * Ticks per hash-to-index reduction, in isolation from the rest of a lookup.
+ */
+static double bench_reduce(const bool pow2) {
+  hash_reducer reducer;
+  const unsigned int capacity = h_capacity(TABLE_BENCH_KEYS, pow2, &reducer);
+  const unsigned int iters = 1u << 22;
+
+  // Chain each index into the next hash so the reductions cannot overlap.
+  uint64_t hash = H_FIBONACCI;
+  uint64_t ticks = UINT64_MAX;
+  for (unsigned int n = 0; n < TABLE_BENCH_REPEATS; n++) {
+    const uint64_t start = bench_ticks();
+    for (unsigned int i = 0; i < iters; i++) {
+      hash = (hash ^ h_reduce(hash, capacity, &reducer)) * H_FIBONACCI;
+    }
+    ticks = bench_min(ticks, bench_ticks() - start);
+  }
+
+  bench_sink += hash;
+  return (double)ticks / iters;
+}
+
+/**
+ * Ticks per successful `ht_search` over a table holding every key.
+ */
+static double bench_ht_search(char **keys, const bool pow2) {
+  hash_opts opts = {.pow2_capacity = pow2};
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+  for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+    ht_insert(ht, keys[i], keys[i]);
+  }
+
+  uint64_t ticks = UINT64_MAX;
+  for (unsigned int n = 0; n < TABLE_BENCH_REPEATS; n++) {
+    const uint64_t start = bench_ticks();
+    for (unsigned int r = 0; r < TABLE_BENCH_ROUNDS; r++) {
+      for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+        bench_sink += (uintptr_t)ht_search(ht, keys[i]);
+      }
+    }
+    ticks = bench_min(ticks, bench_ticks() - start);
+  }
+
+  ht_delete_table(ht);
+  return (double)ticks / (TABLE_BENCH_KEYS * TABLE_BENCH_ROUNDS);
+}
+
+/**
+ * Ticks per successful `rh_search` over a Robin Hood table holding every key.
+ */
+static double bench_rh_search(char **keys, const bool pow2) {
+  hash_opts opts = {.pow2_capacity = pow2};
+  rh_table *rh = rh_init_opts(0, NULL, &opts);
+  for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+    rh_insert(rh, keys[i], keys[i]);
+  }
+
+  uint64_t ticks = UINT64_MAX;
+  for (unsigned int n = 0; n < TABLE_BENCH_REPEATS; n++) {
+    const uint64_t start = bench_ticks();
+    for (unsigned int r = 0; r < TABLE_BENCH_ROUNDS; r++) {
+      for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+        bench_sink += (uintptr_t)rh_search(rh, keys[i]);
+      }
+    }
+    ticks = bench_min(ticks, bench_ticks() - start);
+  }
+
+  rh_delete_table(rh);
+  return (double)ticks / (TABLE_BENCH_KEYS * TABLE_BENCH_ROUNDS);
+}
+
+/**
+ * Ticks per successful `hs_contains` over a set holding every key.
+ */
+static double bench_hs_contains(char **keys, const bool pow2) {
+  hash_opts opts = {.pow2_capacity = pow2};
+  hash_set *hs = hs_init_opts(0, &opts);
+  for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+    hs_insert(hs, keys[i]);
+  }
+
+  uint64_t ticks = UINT64_MAX;
+  for (unsigned int n = 0; n < TABLE_BENCH_REPEATS; n++) {
+    const uint64_t start = bench_ticks();
+    for (unsigned int r = 0; r < TABLE_BENCH_ROUNDS; r++) {
+      for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+        bench_sink += (uint64_t)hs_contains(hs, keys[i]);
+      }
+    }
+    ticks = bench_min(ticks, bench_ticks() - start);
+  }
+
+  hs_delete_set(hs);
+  return (double)ticks / (TABLE_BENCH_KEYS * TABLE_BENCH_ROUNDS);
+}
+
+/**
+ * Ticks per successful lookup of an integer ID, either formatted into a
+ * string key for `ht_search` or passed straight to `u64_search`.
+ */
+static double bench_id_search(const bool u64) {
+  char buf[24];
+  hash_table *ht = ht_init(0, NULL);
+  u64_table *ut = u64_init(0, NULL);
+  for (uint64_t i = 0; i < TABLE_BENCH_KEYS; i++) {
+    // Spread the IDs out, as real ones would be.
+    const uint64_t id = i * H_FIBONACCI;
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)id);
+    ht_insert(ht, buf, NULL);
+    u64_insert(ut, id, NULL);
+  }
+
+  uint64_t ticks = UINT64_MAX;
+  for (unsigned int n = 0; n < TABLE_BENCH_REPEATS; n++) {
+    const uint64_t start = bench_ticks();
+    for (unsigned int r = 0; r < TABLE_BENCH_ROUNDS; r++) {
+      for (uint64_t i = 0; i < TABLE_BENCH_KEYS; i++) {
+        const uint64_t id = i * H_FIBONACCI;
+        if (u64) {
+          bench_sink += (uintptr_t)u64_search(ut, id);
+        } else {
+          snprintf(buf, sizeof(buf), "%llu", (unsigned long long)id);
+          bench_sink += (uintptr_t)ht_search(ht, buf);
+        }
+      }
+    }
+    ticks = bench_min(ticks, bench_ticks() - start);
+  }
+
+  ht_delete_table(ht);
+  u64_delete_table(ut);
+  return (double)ticks / (TABLE_BENCH_KEYS * TABLE_BENCH_ROUNDS);
+}
+
+/**
+ * Ticks per key to fill a table with every key and then delete it, with keys
+ * copied one allocation each or into the table's arena.
+ */
+static double bench_build(char **keys, const bool arena) {
+  hash_opts opts = {.arena_keys = arena};
+
+  uint64_t ticks = UINT64_MAX;
+  for (unsigned int n = 0; n < TABLE_BENCH_REPEATS; n++) {
+    const uint64_t start = bench_ticks();
+    for (unsigned int r = 0; r < TABLE_BENCH_ROUNDS / 16; r++) {
+      hash_table *ht = ht_init_opts(0, NULL, &opts);
+      for (unsigned int i = 0; i < TABLE_BENCH_KEYS; i++) {
+        ht_insert(ht, keys[i], NULL);
+      }
+      ht_delete_table(ht);
+    }
+    ticks = bench_min(ticks, bench_ticks() - start);
+  }
+
+  return (double)ticks / (TABLE_BENCH_KEYS * (TABLE_BENCH_ROUNDS / 16));
+}
+
+void run_table_bench(void) {
+  char **keys = make_keys(TABLE_BENCH_KEYS);
+
+  printf("\ntable: %ss/op, %u keys (lower is better)\n", BENCH_TICK_UNIT,
+         TABLE_BENCH_KEYS);
+  printf("%12s %10s %10s %10s\n", "op", "prime", "pow2", "speedup");
+
+  const double reduce_prime = bench_reduce(false);
+  const double reduce_pow2 = bench_reduce(true);
+  printf("%12s %10.2f %10.2f %9.1fx\n", "reduce", reduce_prime, reduce_pow2,
+         reduce_prime / reduce_pow2);
+
+  const double ht_prime = bench_ht_search(keys, false);
+  const double ht_pow2 = bench_ht_search(keys, true);
+  printf("%12s %10.2f %10.2f %9.1fx\n", "ht_search", ht_prime, ht_pow2,
+         ht_prime / ht_pow2);
+
+  const double rh_prime = bench_rh_search(keys, false);
+  const double rh_pow2 = bench_rh_search(keys, true);
+  printf("%12s %10.2f %10.2f %9.1fx\n", "rh_search", rh_prime, rh_pow2,
+         rh_prime / rh_pow2);
+
+  const double hs_prime = bench_hs_contains(keys, false);
+  const double hs_pow2 = bench_hs_contains(keys, true);
+  printf("%12s %10.2f %10.2f %9.1fx\n", "hs_contains", hs_prime, hs_pow2,
+         hs_prime / hs_pow2);
+
+  printf("\nbuild and delete: %ss/key, %u keys (lower is better)\n",
+         BENCH_TICK_UNIT, TABLE_BENCH_KEYS);
+  printf("%12s %10s %10s %10s\n", "op", "malloc", "arena", "speedup");
+
+  const double build_malloc = bench_build(keys, false);
+  const double build_arena = bench_build(keys, true);
+  printf("%12s %10.2f %10.2f %9.1fx\n", "ht_insert", build_malloc,
+         build_arena, build_malloc / build_arena);
+
+  printf("\nid lookup: %ss/op, %u keys (lower is better)\n", BENCH_TICK_UNIT,
+         TABLE_BENCH_KEYS);
+  printf("%12s %10s %10s %10s\n", "op", "ht_search", "u64_search", "speedup");
+
+  const double id_ht = bench_id_search(false);
+  const double id_u64 = bench_id_search(true);
+  printf("%12s %10.2f %10.2f %9.1fx\n", "search", id_ht, id_u64,
+         id_ht / id_u64);
+
+  free_keys(keys, TABLE_BENCH_KEYS);
+}
@@ -1,11 +1,18 @@
 #ifndef LIBHASH_H
 #define LIBHASH_H
 
-#include "list.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #define HT_DEFAULT_CAPACITY 53
 #define HS_DEFAULT_CAPACITY 53
 
+/**
+ * Pass to `ht_rehash` to finish an in-progress rehash.
+ */
+#define HT_REHASH_ALL ((unsigned int)-1)
+
 /**
  * A free function that will be invoked a hashmap value any time it is removed.
  *
@@ -18,20 +25,162 @@ typedef void free_fn(void *value);
  * A hash table entry i.e. key / value pair
  */
 typedef struct {
+  /**
+   * A copy of the key's bytes, always followed by a NUL terminator so keys
+   * inserted as strings read back as strings - or, with
+   * hash_opts.borrow_keys, the caller's key itself. Keys inserted with the
+   * `_n` functions may contain NUL bytes themselves; `key_len` is
+   * authoritative.
+   */
   char *key;
+  size_t key_len;
+
   void *value;
+
+  union {
+    /**
+     * The full hash of `key`. Compared before the key itself on lookup, and
+     * reused to place the entry when the table is resized.
+     */
+    uint64_t hash;
+
+    /**
+     * Internal: for a hole a delete left in a hash_table's entries array
+     * (`key` is NULL), the position at the other end of the run of holes it
+     * belongs to. Only kept up to date at the two ends of each run.
+     */
+    unsigned int hole_end;
+  };
 } ht_entry;
 
+/**
+ * Internal: a chunk of a table's key arena. See hash_opts.arena_keys.
+ */
+struct h_arena_chunk;
+
+/**
+ * A custom allocator, through which a table or set makes every one of its
+ * allocations: the table itself, its buckets, and its keys. `ctx` is passed
+ * to each function as is, e.g. to identify a pool or a tenant. Sizes are
+ * passed back to `resize` and `release`, so an allocator need not track
+ * them. Without `alloc`, the table uses malloc, realloc and free, and the
+ * other functions are ignored. `resize` and `release` are optional: without
+ * `resize`, an allocation is resized by allocating anew and copying, and
+ * without `release`, nothing is freed one allocation at a time, as suits a
+ * pool or arena the caller frees as a whole.
+ */
+typedef struct {
+  void *(*alloc)(void *ctx, size_t size);
+
+  /**
+   * Resize the allocation `ptr` (never NULL) from `old_size` to `size` bytes,
+   * keeping its contents.
+   */
+  void *(*resize)(void *ctx, void *ptr, size_t old_size, size_t size);
+
+  void (*release)(void *ctx, void *ptr, size_t size);
+
+  void *ctx;
+} hash_allocator;
+
+/**
+ * Optional settings for `ht_init_opts` and `hs_init_opts`. A zeroed struct -
+ * or passing NULL - gives the same table as `ht_init` (or set as `hs_init`).
+ */
+typedef struct {
+  /**
+   * Number of buckets to migrate per insert or delete while the table is
+   * being resized. If 0, a resize migrates every bucket at once inside the
+   * insert or delete that triggered it. Otherwise the new buckets are
+   * allocated up front and the old ones are drained incrementally, which
+   * bounds the work done by any single operation. A step of 2 or more ensures
+   * each migration completes before the table grows again.
+   */
+  unsigned int rehash_step;
+
+  /**
+   * If set, capacities are powers of two rather than primes, and hashes are
+   * mapped onto buckets with a multiply and a shift instead of an integer
+   * division. Lookups then perform no division at all. Applies to hash sets
+   * as well as hash tables.
+   */
+  bool pow2_capacity;
+
+  /**
+   * If set, the caller's key pointers are stored as-is rather than copied,
+   * saving an allocation per key. Each key must then stay valid and unchanged
+   * for as long as it is in the table or set, and is never freed by it. Keys
+   * inserted with the `_n` functions need not be NUL-terminated, and neither
+   * are the `key`s of their entries. Applies to hash sets and Robin Hood
+   * tables as well as hash tables.
+   */
+  bool borrow_keys;
+
+  /**
+   * If set (and `borrow_keys` is not), keys are copied into large chunks of
+   * memory owned by the table rather than each into an allocation of its own.
+   * Inserts then almost never call malloc, and deleting the table frees a
+   * handful of chunks instead of every key. Deleting a key does not reclaim
+   * its bytes until the table is deleted, so this suits tables that are
+   * filled and then discarded whole rather than ones with heavy churn.
+   * Applies to hash sets and Robin Hood tables as well as hash tables.
+   */
+  bool arena_keys;
+
+  /**
+   * The allocator to make every allocation with. Left zeroed, the table uses
+   * malloc, realloc and free. Applies to every table type and hash sets.
+   * Concurrent tables call it from whichever thread is inserting or
+   * resizing, so for them it must be thread-safe.
+   */
+  hash_allocator allocator;
+
+  /**
+   * Number of lock stripes of a concurrent table, rounded up to a power of
+   * two; 0 means CT_DEFAULT_STRIPES. More stripes mean less contention between
+   * writers, at the cost of a slower resize. Applies to concurrent tables
+   * only.
+   */
+  unsigned int stripes;
+
+  /**
+   * Number of shards of a sharded table, rounded up to a power of two; 0
+   * means SH_DEFAULT_SHARDS. Applies to sharded tables only. Every other
+   * setting applies to each shard as it would to a hash table.
+   */
+  unsigned int shards;
+} hash_opts;
+
+/**
+ * Internal: how hashes are mapped onto the buckets of a table or set at its
+ * current capacity. See `h_reduce` in src/hash.h.
+ */
+typedef struct {
+  /**
+   * For a prime capacity, the fastmod reciprocal ceil(2^64 / capacity);
+   * 0 otherwise.
+   */
+  uint64_t magic;
+
+  /**
+   * For a power-of-two capacity, 64 - log2(capacity); 0 otherwise.
+   */
+  unsigned int shift;
+} hash_reducer;
+
 /**
  * A hash table
  */
 typedef struct {
   /**
    * Max number of entries which may be stored in the hash table. Adjustable.
-   * Calculated as the first prime subsequent to the base capacity.
+   * Calculated as the first growth prime (see src/prime.c) at or above the
+   * base capacity, or the first power of two if `opts.pow2_capacity` is set.
    */
   unsigned int capacity;
 
+  hash_reducer reducer;
+
   /**
    * Base capacity (used to calculate load for resizing)
    */
@@ -43,9 +192,43 @@ typedef struct {
   unsigned int count;
 
   /**
-   * The hash table's entries
+   * One control byte per bucket, plus a mirrored tail (see src/group.h).
+   * Occupied buckets hold 7 bits of their key's hash; empty and deleted
+   * buckets hold marker values. Lookups scan these a group at a time and
+   * only read an entry for buckets whose tag matches.
+   */
+  uint8_t *ctrl;
+
+  /**
+   * The sparse half of the table: per occupied bucket, the position of the
+   * bucket's entry in `entries`. This is also the allocation that `ctrl`
+   * points into.
+   */
+  uint32_t *index;
+
+  /**
+   * The dense half of the table: every entry, in insertion order. Deleting
+   * an entry leaves a hole, with a NULL key, which is closed when the array
+   * is next compacted. `entries_len` positions are in use, holes included,
+   * out of `entries_cap`.
+   */
+  ht_entry *entries;
+  unsigned int entries_len;
+  unsigned int entries_cap;
+
+  /**
+   * Number of buckets holding a deleted marker (see ht_delete). When these
+   * push the effective load past the growth limit while the live load stays
+   * under it, the table is rehashed in place to clear them.
+   */
+  unsigned int deleted;
+
+  /**
+   * Number of times the table has been resized, and rehashed in place. See
+   * ht_get_stats.
    */
-  ht_entry **entries;
+  unsigned int resizes;
+  unsigned int purges;
 
   /**
    * Either a free_fn* or NULL; if set, this function pointer will be invoked
@@ -54,9 +237,50 @@ typedef struct {
    */
   free_fn *free_value;
 
-  node_t *occupied_buckets;
+  /**
+   * While an incremental rehash is in progress, the index being migrated
+   * away from; NULL otherwise. Lookups consult it after the current index.
+   * Old buckets before `rehash_idx` have already been migrated. As with
+   * `ctrl` and `index`, both live in the one allocation owned by
+   * `old_index`.
+   */
+  uint8_t *old_ctrl;
+  uint32_t *old_index;
+  unsigned int old_capacity;
+  hash_reducer old_reducer;
+  unsigned int rehash_idx;
+
+  /**
+   * Storage for keys if `opts.arena_keys` is set; NULL otherwise.
+   */
+  struct h_arena_chunk *arena;
+
+  hash_opts opts;
 } hash_table;
 
+/**
+ * A snapshot of a hash table's occupancy and probe lengths. See ht_get_stats.
+ */
+typedef struct {
+  unsigned int capacity;
+  unsigned int count;
+
+  /**
+   * Number of buckets holding a deleted marker
+   */
+  unsigned int deleted;
+
+  unsigned int resizes;
+  unsigned int purges;
+
+  /**
+   * Mean and maximum number of control groups a lookup of each present key
+   * probes, counting the group where the key is found
+   */
+  double mean_probe_groups;
+  unsigned int max_probe_groups;
+} ht_stats;
+
 /**
  * Initialize a new hash table with a size of `max_size`
  *
@@ -67,7 +291,31 @@ typedef struct {
 hash_table *ht_init(int base_capacity, free_fn *free_value);
 
 /**
- * Insert a key, value pair into the given hash table.
+ * Initialize a new hash table with the given settings. See hash_opts.
+ *
+ * @param base_capacity The hash table capacity
+ * @param free_value See free_fn
+ * @param opts Settings, or NULL for the defaults
+ * @return hash_table*
+ */
+hash_table *ht_init_opts(int base_capacity, free_fn *free_value,
+                         const hash_opts *opts);
+
+/**
+ * Migrate up to `buckets` buckets of an in-progress incremental rehash. Inserts
+ * and deletes already do this according to the table's `rehash_step`; this may
+ * be called to drive a migration forward, e.g. while idle.
+ *
+ * @param ht
+ * @param buckets Number of old buckets to migrate, or HT_REHASH_ALL
+ * @return int 1 if a rehash is still in progress, else 0
+ */
+int ht_rehash(hash_table *ht, unsigned int buckets);
+
+/**
+ * Insert a key, value pair into the given hash table. If the key is already
+ * present its value is overwritten in place, and the old value is passed to
+ * the table's `free_value` (if any) unless it is the value being stored.
  *
  * @param ht
  * @param key
@@ -75,13 +323,64 @@ hash_table *ht_init(int base_capacity, free_fn *free_value);
 void ht_insert(hash_table *ht, const char *key, void *value);
 
 /**
- * Search for the entry corresponding to the given key
+ * Insert a key, value pair into the given hash table, where the key is `len`
+ * bytes of arbitrary data rather than a NUL-terminated string. The string
+ * functions are equivalent to these with `len` set to `strlen(key)`, so the
+ * two may be mixed.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param value
+ */
+void ht_insert_n(hash_table *ht, const void *key, size_t len, void *value);
+
+/**
+ * Find the value slot for the given key, inserting the key with a NULL value
+ * if it is not yet present. Lets read-modify-write updates, e.g. counting, be
+ * done with a single lookup, and with no allocation when the key is present.
+ * Like the pointer returned by ht_search, the slot is only valid until the
+ * next insert or delete on the table.
+ *
+ * @param ht
+ * @param key
+ * @param inserted If not NULL, set to whether the key was inserted
+ * @return void** The key's value slot
+ */
+void **ht_get_or_insert(hash_table *ht, const char *key, bool *inserted);
+
+/**
+ * See ht_get_or_insert and ht_insert_n.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param inserted If not NULL, set to whether the key was inserted
+ * @return void** The key's value slot
+ */
+void **ht_get_or_insert_n(hash_table *ht, const void *key, size_t len,
+                          bool *inserted);
+
+/**
+ * Search for the entry corresponding to the given key. Entries are stored
+ * inline in the table, so the returned pointer is only valid until the next
+ * insert or delete on the table.
  *
  * @param ht
  * @param key
  */
 ht_entry *ht_search(hash_table *ht, const char *key);
 
+/**
+ * Search for the entry corresponding to the given `len` byte key. See
+ * ht_insert_n and ht_search.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ */
+ht_entry *ht_search_n(hash_table *ht, const void *key, size_t len);
+
 /**
  * Eagerly retrieve the value inside of the entry stored at the given key.
  * Will segfault if the key entry does not exist.
@@ -91,6 +390,25 @@ ht_entry *ht_search(hash_table *ht, const char *key);
  */
 void *ht_get(hash_table *ht, const char *key);
 
+/**
+ * Retrieve the value stored at the given `len` byte key. See ht_insert_n and
+ * ht_get.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ */
+void *ht_get_n(hash_table *ht, const void *key, size_t len);
+
+/**
+ * Fill `stats` with a snapshot of the table's occupancy and probe lengths.
+ * This walks every bucket.
+ *
+ * @param ht
+ * @param stats
+ */
+void ht_get_stats(hash_table *ht, ht_stats *stats);
+
 /**
  * Delete a hash table and deallocate its memory
  *
@@ -101,8 +419,8 @@ void ht_delete_table(hash_table *ht);
 /**
  * Delete a entry for the given key `key`. Because entries
  * may be part of a collision chain, and removing them completely
- * could cause infinite lookup attempts, we replace the deleted entry
- * with a NULL sentinel entry.
+ * could cause lookups to end early, we mark the deleted entry's bucket
+ * as deleted rather than empty.
  *
  * @param ht
  * @param key
@@ -112,19 +430,45 @@ void ht_delete_table(hash_table *ht);
  */
 int ht_delete(hash_table *ht, const char *key);
 
-#define HT_ITER_START(ht)                \
-  node_t *head = ht->occupied_buckets;   \
-  while (!list_is_sentinel_node(head)) { \
-    ht_entry *entry = ht->entries[head->value];
+/**
+ * Delete the entry for the given `len` byte key. See ht_insert_n and
+ * ht_delete.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ * @return 1 if a entry was deleted, else 0
+ */
+int ht_delete_n(hash_table *ht, const void *key, size_t len);
+
+/**
+ * Iterate the table's entries, most recently inserted first. This is a
+ * backwards walk over the dense entries array. The walk always reaches a run
+ * of holes at its top, which links to the bottom of the run, so each run is
+ * skipped in one step.
+ */
+#define HT_ITER_START(ht)                                      \
+  for (unsigned int __ht_iter_pos = (ht)->entries_len;         \
+       __ht_iter_pos-- > 0;) {                                 \
+    ht_entry *entry = &(ht)->entries[__ht_iter_pos];           \
+    if (entry->key == NULL) {                                  \
+      __ht_iter_pos = entry->hole_end;                         \
+      continue;                                                \
+    }
 
-#define HT_ITER_END  \
-  head = head->next; \
-  }
+#define HT_ITER_END }
 
+/**
+ * A hash table using Robin Hood linear probing - an alternative engine to
+ * hash_table with the same key / value semantics. On insert, an entry that is
+ * further from its home bucket than a resident takes the resident's bucket,
+ * which keeps probe lengths short and even. Deletes shift the following
+ * entries back rather than leaving a deleted marker, so probe sequences never
+ * lengthen under churn.
+ */
 typedef struct {
   /**
-   * Max number of keys which may be stored in the hash set. Adjustable.
-   * Calculated as the first prime subsequent to the base capacity.
+   * Number of buckets. See hash_table.capacity.
    */
   unsigned int capacity;
 
@@ -134,57 +478,881 @@ typedef struct {
   unsigned int base_capacity;
 
   /**
-   * Number of non-NULL keys in the hash set
+   * Number of entries in the table
    */
   unsigned int count;
 
   /**
-   * The hash set's keys
+   * Per bucket, 0 if the bucket is empty, else 1 + the distance of its entry
+   * from the entry's home bucket.
    */
-  char **keys;
-} hash_set;
+  uint32_t *dist;
+
+  /**
+   * The table's entries, stored inline and indexed by bucket. Only buckets
+   * with a non-zero `dist` hold a valid entry. This is also the allocation
+   * that `dist` points into.
+   */
+  ht_entry *entries;
+
+  /**
+   * See hash_table.free_value.
+   */
+  free_fn *free_value;
+
+  hash_reducer reducer;
+
+  /**
+   * See hash_table.arena.
+   */
+  struct h_arena_chunk *arena;
+
+  hash_opts opts;
+} rh_table;
 
 /**
- * Initialize a new hash set with a size of `max_size`
+ * Initialize a new Robin Hood hash table. See ht_init.
  *
- * @param max_size The hash set capacity
- * @return hash_set*
+ * @param base_capacity The hash table capacity
+ * @param free_value See free_fn
+ * @return rh_table*
  */
-hash_set *hs_init(int base_capacity);
+rh_table *rh_init(int base_capacity, free_fn *free_value);
 
 /**
- * Insert a key into the given hash set.
+ * Initialize a new Robin Hood hash table with the given settings. See
+ * hash_opts; `rehash_step` does not apply, as these tables always resize at
+ * once.
  *
- * @param hs
+ * @param base_capacity The hash table capacity
+ * @param free_value See free_fn
+ * @param opts Settings, or NULL for the defaults
+ * @return rh_table*
+ */
+rh_table *rh_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts);
+
+/**
+ * Insert a key, value pair into the given table. See ht_insert.
+ *
+ * @param rh
  * @param key
+ * @param value
  */
-void hs_insert(hash_set *hs, const void *key);
+void rh_insert(rh_table *rh, const char *key, void *value);
 
 /**
- * Check whether the given hash set contains a key `key`
+ * Search for the entry corresponding to the given key. The returned pointer
+ * is only valid until the next insert or delete on the table.
  *
- * @param hs
+ * @param rh
  * @param key
- * @return 1 for true, 0 for false
+ * @return ht_entry*
  */
-int hs_contains(hash_set *hs, const char *key);
+ht_entry *rh_search(rh_table *rh, const char *key);
 
 /**
- * Delete a hash set and deallocate its memory
+ * Retrieve the value stored at the given key, or NULL if there is none.
  *
- * @param hs Hash set to delete
+ * @param rh
+ * @param key
  */
-void hs_delete_set(hash_set *hs);
+void *rh_get(rh_table *rh, const char *key);
 
 /**
- * Delete the given key `key`.
+ * Delete a Robin Hood hash table and deallocate its memory
  *
- * @param hs
+ * @param rh Table to delete
+ */
+void rh_delete_table(rh_table *rh);
+
+/**
+ * Delete the entry for the given key `key`.
+ *
+ * @param rh
  * @param key
  *
- * @return 1 if a key was deleted, 0 if the given key did not already exist
- * in the set
+ * @return 1 if an entry was deleted, 0 if no entry corresponding
+ * to the given key could be found
  */
-int hs_delete(hash_set *hs, const char *key);
+int rh_delete(rh_table *rh, const char *key);
+
+/**
+ * An integer-keyed table entry. Both halves are stored inline in the table.
+ */
+typedef struct {
+  uint64_t key;
+  void *value;
+} u64_entry;
+
+/**
+ * A hash table keyed by 64-bit integers, e.g. IDs. Probes SwissTable-style
+ * control bytes as hash_table does, but hashes each key with a bijective
+ * integer mixer rather than as a string, and stores its entries inline in
+ * the buckets, so inserts perform no allocation beyond resizing.
+ */
+typedef struct {
+  /**
+   * Number of buckets. See hash_table.capacity.
+   */
+  unsigned int capacity;
+
+  hash_reducer reducer;
+
+  /**
+   * Base capacity (used to calculate load for resizing)
+   */
+  unsigned int base_capacity;
+
+  /**
+   * Number of entries in the table
+   */
+  unsigned int count;
+
+  /**
+   * Number of buckets holding a deleted marker. See hash_table.deleted.
+   */
+  unsigned int deleted;
+
+  /**
+   * One control byte per bucket, plus a mirrored tail. See hash_table.ctrl.
+   * An occupied bucket's control byte has its high bit clear.
+   */
+  uint8_t *ctrl;
+
+  /**
+   * The table's entries, indexed by bucket. Only buckets whose control byte
+   * marks them occupied hold a valid entry. This is also the allocation that
+   * `ctrl` points into.
+   */
+  u64_entry *entries;
+
+  /**
+   * See hash_table.free_value.
+   */
+  free_fn *free_value;
+
+  hash_opts opts;
+} u64_table;
+
+/**
+ * Initialize a new integer-keyed table. See ht_init.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @return u64_table*
+ */
+u64_table *u64_init(int base_capacity, free_fn *free_value);
+
+/**
+ * Initialize a new integer-keyed table with the given settings. See
+ * hash_opts; `rehash_step` does not apply, as these tables always resize at
+ * once.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @param opts Settings, or NULL for the defaults
+ * @return u64_table*
+ */
+u64_table *u64_init_opts(int base_capacity, free_fn *free_value,
+                         const hash_opts *opts);
+
+/**
+ * Insert a key, value pair into the given table. See ht_insert.
+ *
+ * @param ut
+ * @param key
+ * @param value
+ */
+void u64_insert(u64_table *ut, uint64_t key, void *value);
+
+/**
+ * Search for the entry corresponding to the given key. The returned pointer
+ * is only valid until the next insert or delete on the table.
+ *
+ * @param ut
+ * @param key
+ * @return u64_entry*
+ */
+u64_entry *u64_search(u64_table *ut, uint64_t key);
+
+/**
+ * Retrieve the value stored at the given key, or NULL if there is none.
+ *
+ * @param ut
+ * @param key
+ */
+void *u64_get(u64_table *ut, uint64_t key);
+
+/**
+ * Delete an integer-keyed table and deallocate its memory
+ *
+ * @param ut Table to delete
+ */
+void u64_delete_table(u64_table *ut);
+
+/**
+ * Delete the entry for the given key `key`.
+ *
+ * @param ut
+ * @param key
+ *
+ * @return 1 if an entry was deleted, 0 if no entry corresponding
+ * to the given key could be found
+ */
+int u64_delete(u64_table *ut, uint64_t key);
+
+/**
+ * Iterate the table's entries, in bucket order.
+ */
+#define U64_ITER_START(ut)                                     \
+  for (unsigned int __u64_iter_idx = 0;                        \
+       __u64_iter_idx < (ut)->capacity; __u64_iter_idx++) {    \
+    u64_entry *entry = &(ut)->entries[__u64_iter_idx];         \
+    if ((ut)->ctrl[__u64_iter_idx] & 0x80) {                   \
+      continue;                                                \
+    }
+
+#define U64_ITER_END }
+
+#define CT_DEFAULT_STRIPES 64
+
+/**
+ * Internal: one lock stripe of a concurrent table, and the state of its
+ * growth. See ct_table.
+ */
+struct ct_stripe;
+struct ct_growth;
+
+/**
+ * A thread-safe hash table. Its buckets are partitioned into stripes, each
+ * guarded by a reader-writer lock on a cache line of its own: a key belongs to
+ * the stripe picked by its hash, and is only ever probed for within that
+ * stripe's buckets. Lookups of different keys then mostly take different
+ * locks, and lookups of the same stripe share its lock.
+ *
+ * A stripe that fills up grows the whole table, but no thread migrates it
+ * alone: growing only raises the target stripe capacity, and each stripe is
+ * then rebuilt at it under its own lock by whichever thread claims it first.
+ * The thread that grew the table claims stripes until none are left, every
+ * insert and delete claims one on its way, and `ct_help_resize` lets any
+ * other thread join in. Until it is claimed, a stripe is still searched at
+ * its old capacity, so no operation waits for the whole table to migrate.
+ *
+ * Keys and values follow the same rules as hash_table, with one more: a value
+ * returned by `ct_get` may be freed by a concurrent delete if the table has a
+ * `free_value`, so callers sharing values between threads must manage their
+ * lifetime themselves.
+ */
+typedef struct {
+  struct ct_growth *growth;
+
+  /**
+   * Number of stripes, a power of two
+   */
+  unsigned int stripe_count;
+
+  struct ct_stripe *stripes;
+
+  /**
+   * The allocation `stripes` points into, aligned to a cache line within it.
+   */
+  void *stripes_alloc;
+
+  /**
+   * See hash_table.free_value.
+   */
+  free_fn *free_value;
+
+  hash_opts opts;
+} ct_table;
+
+/**
+ * Initialize a new concurrent table. See ht_init. `base_capacity` is the
+ * capacity of the whole table, divided evenly between the stripes.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @return ct_table*
+ */
+ct_table *ct_init(int base_capacity, free_fn *free_value);
+
+/**
+ * Initialize a new concurrent table with the given settings. See hash_opts;
+ * `rehash_step` does not apply.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @param opts Settings, or NULL for the defaults
+ * @return ct_table*
+ */
+ct_table *ct_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts);
+
+/**
+ * Insert a key, value pair into the given table. See ht_insert. Safe to call
+ * from any thread.
+ *
+ * @param ct
+ * @param key
+ * @param value
+ */
+void ct_insert(ct_table *ct, const char *key, void *value);
+
+/**
+ * Insert a `len` byte key. See ht_insert_n.
+ *
+ * @param ct
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param value
+ */
+void ct_insert_n(ct_table *ct, const void *key, size_t len, void *value);
+
+/**
+ * Retrieve the value stored at the given key, or NULL if there is none. Safe
+ * to call from any thread. There is no `ct_search`: an entry may move as soon
+ * as its stripe is unlocked.
+ *
+ * @param ct
+ * @param key
+ */
+void *ct_get(ct_table *ct, const char *key);
+
+/**
+ * See ct_get.
+ *
+ * @param ct
+ * @param key
+ * @param len Length of `key` in bytes
+ */
+void *ct_get_n(ct_table *ct, const void *key, size_t len);
+
+/**
+ * Delete the entry for the given key `key`. Safe to call from any thread.
+ *
+ * @param ct
+ * @param key
+ *
+ * @return 1 if an entry was deleted, 0 if no entry corresponding
+ * to the given key could be found
+ */
+int ct_delete(ct_table *ct, const char *key);
+
+/**
+ * See ct_delete.
+ *
+ * @param ct
+ * @param key
+ * @param len Length of `key` in bytes
+ * @return 1 if an entry was deleted, else 0
+ */
+int ct_delete_n(ct_table *ct, const void *key, size_t len);
+
+/**
+ * Number of entries in the table. Each stripe is counted under its own lock,
+ * so while other threads insert or delete this is only an estimate.
+ *
+ * @param ct
+ * @return unsigned int
+ */
+unsigned int ct_count(ct_table *ct);
+
+/**
+ * Fill `stats` with a snapshot of the table's occupancy and probe lengths,
+ * summed over its stripes. See ht_get_stats. Each stripe is read under its
+ * own lock, so while other threads write this is only an estimate. A stripe
+ * not yet migrated to the table's new capacity counts at its old one.
+ *
+ * @param ct
+ * @param stats
+ */
+void ct_get_stats(ct_table *ct, ht_stats *stats);
+
+/**
+ * Migrate stripes of the table to its new capacity while any are left
+ * unclaimed, for threads that would otherwise sit idle while the table grows,
+ * such as a pool of workers. Safe to call from any thread; returns at once if
+ * the table is not growing.
+ *
+ * @param ct
+ * @return unsigned int The number of stripes this call migrated
+ */
+unsigned int ct_help_resize(ct_table *ct);
+
+/**
+ * Delete a concurrent table and deallocate its memory. No other thread may be
+ * using it.
+ *
+ * @param ct Table to delete
+ */
+void ct_delete_table(ct_table *ct);
+
+/**
+ * Internal: the bucket array, deferred frees, registered threads and writer
+ * lock of a lock-free table, which threads share. See lf_table.
+ */
+struct lf_state;
+
+/**
+ * A thread registered to read from a lock-free table. See lf_thread_register.
+ */
+typedef struct lf_thread lf_thread;
+
+/**
+ * A thread-safe hash table for read-mostly workloads. Lookups take no lock
+ * and make no atomic writes, so any number of threads can read at once
+ * without contending for a single cache line.
+ *
+ * Each bucket holds a pointer to an immutable entry. Writers change a bucket
+ * with a compare-and-swap: an insert claims an empty bucket, an update swaps
+ * in a new entry, and a delete swaps in a tombstone. Writers work
+ * concurrently with one another; only a resize, which copies the entry
+ * pointers into a new bucket array, excludes other writers. It never blocks
+ * readers, which finish their lookup on whichever array they started with.
+ *
+ * Replaced entries, their keys and values, and old bucket arrays are freed
+ * only once every reading thread has passed a quiescent state since. This is
+ * quiescent-state-based reclamation (QSBR): every thread that reads must
+ * register with `lf_thread_register` and call `lf_quiescent` whenever it
+ * holds no key, value or entry it got from the table, e.g. between requests.
+ * A value returned by `lf_get` stays valid until the reading thread's next
+ * `lf_quiescent`, even if another thread deletes it or replaces it. A thread
+ * that registers and never calls `lf_quiescent` keeps all of this memory
+ * alive.
+ */
+typedef struct {
+  struct lf_state *state;
+
+  /**
+   * Base capacity (used to calculate load for resizing). Only changes while
+   * writers are excluded.
+   */
+  unsigned int base_capacity;
+
+  /**
+   * Number of times the bucket array has been replaced
+   */
+  unsigned int resizes;
+
+  /**
+   * See hash_table.free_value.
+   */
+  free_fn *free_value;
+
+  hash_opts opts;
+} lf_table;
+
+/**
+ * Initialize a new lock-free table. See ht_init.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @return lf_table*
+ */
+lf_table *lf_init(int base_capacity, free_fn *free_value);
+
+/**
+ * Initialize a new lock-free table with the given settings. See hash_opts;
+ * `rehash_step` does not apply, and neither does `arena_keys`, as writers
+ * store keys concurrently.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @param opts Settings, or NULL for the defaults
+ * @return lf_table*
+ */
+lf_table *lf_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts);
+
+/**
+ * Insert a key, value pair into the given table. See ht_insert. Safe to call
+ * from any thread, registered or not.
+ *
+ * @param lf
+ * @param key
+ * @param value
+ */
+void lf_insert(lf_table *lf, const char *key, void *value);
+
+/**
+ * Insert a `len` byte key. See ht_insert_n.
+ *
+ * @param lf
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param value
+ */
+void lf_insert_n(lf_table *lf, const void *key, size_t len, void *value);
+
+/**
+ * Retrieve the value stored at the given key, or NULL if there is none. The
+ * calling thread must be registered; the value stays valid until it next
+ * calls `lf_quiescent`.
+ *
+ * @param lf
+ * @param key
+ */
+void *lf_get(lf_table *lf, const char *key);
+
+/**
+ * See lf_get.
+ *
+ * @param lf
+ * @param key
+ * @param len Length of `key` in bytes
+ */
+void *lf_get_n(lf_table *lf, const void *key, size_t len);
+
+/**
+ * Delete the entry for the given key `key`. Safe to call from any thread,
+ * registered or not. Its key and value are freed once no reading thread can
+ * still hold them.
+ *
+ * @param lf
+ * @param key
+ *
+ * @return 1 if an entry was deleted, 0 if no entry corresponding
+ * to the given key could be found
+ */
+int lf_delete(lf_table *lf, const char *key);
+
+/**
+ * See lf_delete.
+ *
+ * @param lf
+ * @param key
+ * @param len Length of `key` in bytes
+ * @return 1 if an entry was deleted, else 0
+ */
+int lf_delete_n(lf_table *lf, const void *key, size_t len);
+
+/**
+ * Number of entries in the table. While other threads insert or delete this
+ * is only an estimate.
+ *
+ * @param lf
+ * @return unsigned int
+ */
+unsigned int lf_count(lf_table *lf);
+
+/**
+ * Register the calling thread as a reader of the table. It must call
+ * `lf_quiescent` regularly, and `lf_thread_unregister` before it exits.
+ *
+ * @param lf
+ * @return lf_thread*
+ */
+lf_thread *lf_thread_register(lf_table *lf);
+
+/**
+ * Announce that the calling thread holds nothing it got from the table, so
+ * that memory retired before now may be freed. A single store to a cache line
+ * of the thread's own.
+ *
+ * @param thread
+ */
+void lf_quiescent(lf_thread *thread);
+
+/**
+ * Unregister a reading thread. It must hold nothing it got from the table.
+ *
+ * @param thread
+ */
+void lf_thread_unregister(lf_thread *thread);
+
+/**
+ * Delete a lock-free table and deallocate its memory, including any memory
+ * still awaiting reclamation. No other thread may be using it.
+ *
+ * @param lf Table to delete
+ */
+void lf_delete_table(lf_table *lf);
+
+#define SH_DEFAULT_SHARDS 16
+
+/**
+ * Internal: one shard of a sharded table. See sh_table.
+ */
+struct sh_shard;
+
+/**
+ * A thread-safe table made of independent hash tables, its shards. A key is
+ * routed to a shard by the high bits of its hash, and each shard has its own
+ * reader-writer lock and grows, shrinks and purges on its own. Operations on
+ * different shards run in parallel, and a resize only moves one shard's
+ * entries and only blocks that shard, so it pauses a fraction of the keys
+ * for a fraction of the time a single table's would. With `rehash_step` set,
+ * each shard resizes incrementally too.
+ *
+ * Keys and values follow the same rules as ct_table.
+ */
+typedef struct {
+  /**
+   * Number of shards, a power of two
+   */
+  unsigned int shard_count;
+
+  /**
+   * Number of high hash bits that pick a shard, log2 of `shard_count`
+   */
+  unsigned int shard_bits;
+
+  struct sh_shard *shards;
+
+  /**
+   * The allocation `shards` points into, aligned to a cache line within it.
+   */
+  void *shards_alloc;
+
+  hash_opts opts;
+} sh_table;
+
+/**
+ * Initialize a new sharded table. See ht_init. `base_capacity` is the
+ * capacity of the whole table, divided evenly between the shards.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @return sh_table*
+ */
+sh_table *sh_init(int base_capacity, free_fn *free_value);
+
+/**
+ * Initialize a new sharded table with the given settings. See hash_opts.
+ *
+ * @param base_capacity The table capacity
+ * @param free_value See free_fn
+ * @param opts Settings, or NULL for the defaults
+ * @return sh_table*
+ */
+sh_table *sh_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts);
+
+/**
+ * Insert a key, value pair into the given table. See ht_insert. Safe to call
+ * from any thread.
+ *
+ * @param sh
+ * @param key
+ * @param value
+ */
+void sh_insert(sh_table *sh, const char *key, void *value);
+
+/**
+ * Insert a `len` byte key. See ht_insert_n.
+ *
+ * @param sh
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param value
+ */
+void sh_insert_n(sh_table *sh, const void *key, size_t len, void *value);
+
+/**
+ * Retrieve the value stored at the given key, or NULL if there is none. Safe
+ * to call from any thread.
+ *
+ * @param sh
+ * @param key
+ */
+void *sh_get(sh_table *sh, const char *key);
+
+/**
+ * See sh_get.
+ *
+ * @param sh
+ * @param key
+ * @param len Length of `key` in bytes
+ */
+void *sh_get_n(sh_table *sh, const void *key, size_t len);
+
+/**
+ * Delete the entry for the given key `key`. Safe to call from any thread.
+ *
+ * @param sh
+ * @param key
+ *
+ * @return 1 if an entry was deleted, 0 if no entry corresponding
+ * to the given key could be found
+ */
+int sh_delete(sh_table *sh, const char *key);
+
+/**
+ * See sh_delete.
+ *
+ * @param sh
+ * @param key
+ * @param len Length of `key` in bytes
+ * @return 1 if an entry was deleted, else 0
+ */
+int sh_delete_n(sh_table *sh, const void *key, size_t len);
+
+/**
+ * Number of entries in the table. Each shard is counted under its own lock,
+ * so while other threads insert or delete this is only an estimate.
+ *
+ * @param sh
+ * @return unsigned int
+ */
+unsigned int sh_count(sh_table *sh);
+
+/**
+ * Fill `stats` with a snapshot of one shard's occupancy, resizes and probe
+ * lengths. See ht_get_stats. This walks every bucket of the shard, under its
+ * lock.
+ *
+ * @param sh
+ * @param shard A shard, below `shard_count`
+ * @param stats
+ */
+void sh_get_stats(sh_table *sh, unsigned int shard, ht_stats *stats);
+
+/**
+ * Delete a sharded table and deallocate its memory. No other thread may be
+ * using it.
+ *
+ * @param sh Table to delete
+ */
+void sh_delete_table(sh_table *sh);
+
+/**
+ * A hash set slot. An empty slot has a NULL `key`. A slot whose key was
+ * deleted also has a `key_len` of SIZE_MAX, so that probes carry on past it
+ * to keys placed beyond it.
+ */
+typedef struct {
+  /**
+   * See ht_entry.key.
+   */
+  char *key;
+  size_t key_len;
+
+  /**
+   * The full hash of `key`. See ht_entry.
+   */
+  uint64_t hash;
+} hs_entry;
+
+typedef struct {
+  /**
+   * Max number of keys which may be stored in the hash set. Adjustable.
+   * Calculated as the first growth prime (see src/prime.c) at or above the
+   * base capacity, or the first power of two if `opts.pow2_capacity` is set.
+   */
+  unsigned int capacity;
+
+  hash_reducer reducer;
+
+  /**
+   * Base capacity (used to calculate load for resizing)
+   */
+  unsigned int base_capacity;
+
+  /**
+   * Number of non-NULL keys in the hash set
+   */
+  unsigned int count;
+
+  /**
+   * Number of slots a key was deleted from. See hash_table.deleted.
+   */
+  unsigned int deleted;
+
+  /**
+   * The hash set's slots
+   */
+  hs_entry *entries;
+
+  /**
+   * See hash_table.arena.
+   */
+  struct h_arena_chunk *arena;
+
+  hash_opts opts;
+} hash_set;
+
+/**
+ * Initialize a new hash set with a size of `max_size`
+ *
+ * @param max_size The hash set capacity
+ * @return hash_set*
+ */
+hash_set *hs_init(int base_capacity);
+
+/**
+ * Initialize a new hash set with the given settings. See hash_opts;
+ * `rehash_step` does not apply to hash sets.
+ *
+ * @param base_capacity The hash set capacity
+ * @param opts Settings, or NULL for the defaults
+ * @return hash_set*
+ */
+hash_set *hs_init_opts(int base_capacity, const hash_opts *opts);
+
+/**
+ * Insert a key into the given hash set.
+ *
+ * @param hs
+ * @param key
+ */
+void hs_insert(hash_set *hs, const void *key);
+
+/**
+ * Insert a key of `len` bytes of arbitrary data into the given hash set. See
+ * ht_insert_n.
+ *
+ * @param hs
+ * @param key
+ * @param len Length of `key` in bytes
+ */
+void hs_insert_n(hash_set *hs, const void *key, size_t len);
+
+/**
+ * Check whether the given hash set contains a key `key`
+ *
+ * @param hs
+ * @param key
+ * @return 1 for true, 0 for false
+ */
+int hs_contains(hash_set *hs, const char *key);
+
+/**
+ * Check whether the given hash set contains the `len` byte key `key`
+ *
+ * @param hs
+ * @param key
+ * @param len Length of `key` in bytes
+ * @return 1 for true, 0 for false
+ */
+int hs_contains_n(hash_set *hs, const void *key, size_t len);
+
+/**
+ * Delete a hash set and deallocate its memory
+ *
+ * @param hs Hash set to delete
+ */
+void hs_delete_set(hash_set *hs);
+
+/**
+ * Delete the given key `key`.
+ *
+ * @param hs
+ * @param key
+ *
+ * @return 1 if a key was deleted, 0 if the given key did not already exist
+ * in the set
+ */
+int hs_delete(hash_set *hs, const char *key);
+
+/**
+ * Delete the given `len` byte key `key`.
+ *
+ * @param hs
+ * @param key
+ * @param len Length of `key` in bytes
+ * @return 1 if a key was deleted, else 0
+ */
+int hs_delete_n(hash_set *hs, const void *key, size_t len);
 
 #endif /* LIBHASH_H */
@@ -0,0 +1,264 @@
+#ifndef LIBHASH_MAP_H
+#define LIBHASH_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Header-only, type-specialized hash maps. Unlike hash_table, which stores
+ * `char *` keys and `void *` values, a map generated here stores its keys and
+ * values inline at their own types, and its hash and equality functions are
+ * called directly rather than through pointers. The compiler can then inline
+ * and specialize every operation for each key and value type.
+ *
+ * Each map is open addressed with linear probing over a power-of-two number of
+ * slots, mapped to with a Fibonacci multiply-shift. A control byte per slot
+ * holds 7 bits of the key's hash, so most mismatched slots are rejected
+ * without calling the equality function. Maps own no memory for their keys or
+ * values; releasing those is the caller's business.
+ */
+
+/**
+ * Control bytes. See src/group.h.
+ */
+#define LIBHASH_MAP_EMPTY ((uint8_t)0x80)
+#define LIBHASH_MAP_DELETED ((uint8_t)0xFE)
+
+#define LIBHASH_MAP_MIN_CAPACITY 16
+
+/**
+ * 2^64 divided by the golden ratio. See `h_reduce`.
+ */
+#define LIBHASH_MAP_FIBONACCI 0x9e3779b97f4a7c15ull
+
+/**
+ * Hash a 64-bit integer key with the bijective splitmix64 finalizer. Suitable
+ * as the `hash_fn` of any integer-keyed map.
+ *
+ * @param key
+ * @return uint64_t
+ */
+static inline uint64_t libhash_map_hash_u64(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ull;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebull;
+  key ^= key >> 31;
+  return key;
+}
+
+/**
+ * Hash `len` bytes with FNV-1a, finished with `libhash_map_hash_u64` so the
+ * high bits used for the slot are well mixed.
+ *
+ * @param key
+ * @param len
+ * @return uint64_t
+ */
+static inline uint64_t libhash_map_hash_bytes(const void *key,
+                                              const size_t len) {
+  const uint8_t *p = (const uint8_t *)key;
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001b3ull;
+  }
+
+  return libhash_map_hash_u64(hash);
+}
+
+/**
+ * Hash a NUL-terminated string. Suitable as the `hash_fn` of a map keyed by
+ * `const char *`, alongside `LIBHASH_MAP_STR_EQ`.
+ *
+ * @param key
+ * @return uint64_t
+ */
+static inline uint64_t libhash_map_hash_str(const char *key) {
+  return libhash_map_hash_bytes(key, strlen(key));
+}
+
+/**
+ * Equality functions for `LIBHASH_DEFINE_MAP`: by value, e.g. for integers,
+ * and by string contents.
+ */
+#define LIBHASH_MAP_EQ(a, b) ((a) == (b))
+#define LIBHASH_MAP_STR_EQ(a, b) (strcmp((a), (b)) == 0)
+
+/**
+ * Define a map type `name` from keys of type `K` to values of type `V`, along
+ * with its functions, all `static inline`:
+ *
+ *   void name_init(name *m, unsigned int capacity)
+ *     Initialize an empty map with room for at least `capacity` entries.
+ *   void name_free(name *m)
+ *   int name_insert(name *m, K key, V value)
+ *     Insert or update; returns 1 if the key was inserted, 0 if updated.
+ *   V *name_get(const name *m, K key)
+ *     Returns a pointer to the key's value, or NULL. The pointer is only
+ *     valid until the next insert.
+ *   int name_delete(name *m, K key)
+ *     Returns 1 if the key was deleted, 0 if it was not present.
+ *   name_entry *name_next(const name *m, unsigned int *it)
+ *     Iterate: start with *it = 0 and call until it returns NULL.
+ *
+ * `hash_fn(key)` must return a uint64_t whose every bit depends on the key,
+ * and `eq_fn(a, b)` must return non-zero for equal keys. Either may be a
+ * function or a macro.
+ *
+ * @param name
+ * @param K
+ * @param V
+ * @param hash_fn
+ * @param eq_fn
+ */
+#define LIBHASH_DEFINE_MAP(name, K, V, hash_fn, eq_fn)                        \
+  typedef struct {                                                            \
+    K key;                                                                    \
+    V value;                                                                  \
+  } name##_entry;                                                             \
+                                                                              \
+  typedef struct {                                                            \
+    unsigned int capacity;                                                    \
+    unsigned int shift;                                                       \
+    unsigned int count;                                                       \
+    unsigned int deleted;                                                     \
+    uint8_t *ctrl;                                                            \
+    name##_entry *entries;                                                    \
+  } name;                                                                     \
+                                                                              \
+  static inline unsigned int name##_home(const name *m,                       \
+                                         const uint64_t hash) {               \
+    return (unsigned int)((hash * LIBHASH_MAP_FIBONACCI) >> m->shift);        \
+  }                                                                           \
+                                                                              \
+  static inline void name##_alloc(name *m, const unsigned int capacity) {     \
+    unsigned int shift = 64;                                                  \
+    for (unsigned int c = capacity; c > 1; c >>= 1) {                         \
+      shift--;                                                                \
+    }                                                                         \
+                                                                              \
+    m->capacity = capacity;                                                   \
+    m->shift = shift;                                                         \
+    m->count = 0;                                                             \
+    m->deleted = 0;                                                           \
+    m->entries = malloc((size_t)capacity * (sizeof(name##_entry) + 1));       \
+    m->ctrl = (uint8_t *)(m->entries + capacity);                             \
+    memset(m->ctrl, LIBHASH_MAP_EMPTY, capacity);                             \
+  }                                                                           \
+                                                                              \
+  static inline void name##_init(name *m, const unsigned int capacity) {      \
+    unsigned int c = LIBHASH_MAP_MIN_CAPACITY;                                \
+    while (c * 7 / 10 < capacity) {                                           \
+      c <<= 1;                                                                \
+    }                                                                         \
+                                                                              \
+    name##_alloc(m, c);                                                       \
+  }                                                                           \
+                                                                              \
+  static inline void name##_free(name *m) {                                   \
+    free(m->entries);                                                         \
+    m->entries = NULL;                                                        \
+    m->ctrl = NULL;                                                           \
+    m->capacity = 0;                                                          \
+    m->count = 0;                                                             \
+  }                                                                           \
+                                                                              \
+  static inline long name##_find(const name *m, K key,                        \
+                                 const uint64_t hash) {                       \
+    const uint8_t tag = (uint8_t)(hash & 0x7F);                               \
+    const unsigned int mask = m->capacity - 1;                                \
+    unsigned int idx = name##_home(m, hash);                                  \
+                                                                              \
+    for (;;) {                                                                \
+      const uint8_t ctrl = m->ctrl[idx];                                      \
+      if (ctrl == tag && eq_fn(m->entries[idx].key, key)) {                   \
+        return (long)idx;                                                     \
+      }                                                                       \
+      if (ctrl == LIBHASH_MAP_EMPTY) {                                        \
+        return -1;                                                            \
+      }                                                                       \
+                                                                              \
+      idx = (idx + 1) & mask;                                                 \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  static inline void name##_place(name *m, const name##_entry *r,             \
+                                  const uint64_t hash) {                      \
+    const unsigned int mask = m->capacity - 1;                                \
+    unsigned int idx = name##_home(m, hash);                                  \
+                                                                              \
+    while (!(m->ctrl[idx] & 0x80)) {                                          \
+      idx = (idx + 1) & mask;                                                 \
+    }                                                                         \
+                                                                              \
+    if (m->ctrl[idx] == LIBHASH_MAP_DELETED) {                                \
+      m->deleted--;                                                           \
+    }                                                                         \
+    m->ctrl[idx] = (uint8_t)(hash & 0x7F);                                    \
+    m->entries[idx] = *r;                                                     \
+    m->count++;                                                               \
+  }                                                                           \
+                                                                              \
+  static inline void name##_rehash(name *m, const unsigned int capacity) {    \
+    name old = *m;                                                            \
+                                                                              \
+    name##_alloc(m, capacity);                                                \
+    for (unsigned int i = 0; i < old.capacity; i++) {                         \
+      if (!(old.ctrl[i] & 0x80)) {                                            \
+        name##_place(m, &old.entries[i], hash_fn(old.entries[i].key));        \
+      }                                                                       \
+    }                                                                         \
+                                                                              \
+    free(old.entries);                                                        \
+  }                                                                           \
+                                                                              \
+  static inline int name##_insert(name *m, K key, V value) {                  \
+    const uint64_t hash = hash_fn(key);                                       \
+    const long found = name##_find(m, key, hash);                             \
+    if (found != -1) {                                                        \
+      m->entries[found].value = value;                                        \
+      return 0;                                                               \
+    }                                                                         \
+                                                                              \
+    if ((m->count + m->deleted + 1) * 10 > m->capacity * 7) {                 \
+      name##_rehash(m, m->count * 20 >= m->capacity * 7 ? m->capacity * 2     \
+                                                        : m->capacity);       \
+    }                                                                         \
+                                                                              \
+    const name##_entry r = {key, value};                                      \
+    name##_place(m, &r, hash);                                                \
+    return 1;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline V *name##_get(const name *m, K key) {                         \
+    const long found = name##_find(m, key, hash_fn(key));                     \
+    return found == -1 ? NULL : &m->entries[found].value;                     \
+  }                                                                           \
+                                                                              \
+  static inline int name##_delete(name *m, K key) {                           \
+    const long found = name##_find(m, key, hash_fn(key));                     \
+    if (found == -1) {                                                        \
+      return 0;                                                               \
+    }                                                                         \
+                                                                              \
+    m->ctrl[found] = LIBHASH_MAP_DELETED;                                     \
+    m->deleted++;                                                             \
+    m->count--;                                                               \
+    return 1;                                                                 \
+  }                                                                           \
+                                                                              \
+  static inline name##_entry *name##_next(const name *m, unsigned int *it) {  \
+    while (*it < m->capacity) {                                               \
+      const unsigned int idx = (*it)++;                                       \
+      if (!(m->ctrl[idx] & 0x80)) {                                           \
+        return &m->entries[idx];                                              \
+      }                                                                       \
+    }                                                                         \
+                                                                              \
+    return NULL;                                                              \
+  }
+
+#endif /* LIBHASH_MAP_H */
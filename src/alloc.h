@@ -0,0 +1,118 @@
+#ifndef LIBHASH_ALLOC_H
+#define LIBHASH_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+
+/**
+ * Size of a cache line. State that different threads write to is kept at
+ * least this far apart, so that they do not contend for the same line.
+ */
+#define H_CACHE_LINE 64
+
+/**
+ * Round `ptr` up to the next cache line boundary. An allocation of
+ * H_CACHE_LINE - 1 bytes more than is needed holds it in full from there.
+ *
+ * @param ptr
+ * @return void*
+ */
+static inline void *h_cache_align(void *ptr) {
+  return (void *)(((uintptr_t)ptr + H_CACHE_LINE - 1) &
+                  ~(uintptr_t)(H_CACHE_LINE - 1));
+}
+
+/**
+ * Allocate through the given allocator, or malloc if it has no functions. See
+ * hash_allocator.
+ *
+ * @param allocator
+ * @param size
+ * @return void*
+ */
+static inline void *h_alloc(const hash_allocator *allocator,
+                            const size_t size) {
+  if (allocator->alloc == NULL) {
+    return malloc(size);
+  }
+
+  return allocator->alloc(allocator->ctx, size);
+}
+
+/**
+ * Allocate `n * size` zeroed bytes. See `h_alloc`.
+ *
+ * @param allocator
+ * @param n
+ * @param size
+ * @return void*
+ */
+static inline void *h_calloc(const hash_allocator *allocator, const size_t n,
+                             const size_t size) {
+  if (allocator->alloc == NULL) {
+    return calloc(n, size);
+  }
+
+  void *p = allocator->alloc(allocator->ctx, n * size);
+  memset(p, 0, n * size);
+  return p;
+}
+
+/**
+ * Resize an allocation from `old_size` to `size` bytes, keeping its contents.
+ * `ptr` may be NULL, with an `old_size` of 0. An allocator with no `resize`
+ * gets a new allocation, into which the old one is copied before it is freed.
+ * See `h_alloc`.
+ *
+ * @param allocator
+ * @param ptr
+ * @param old_size
+ * @param size
+ * @return void*
+ */
+static inline void *h_realloc(const hash_allocator *allocator, void *ptr,
+                              const size_t old_size, const size_t size) {
+  if (allocator->alloc == NULL) {
+    return realloc(ptr, size);
+  }
+
+  if (ptr == NULL) {
+    return allocator->alloc(allocator->ctx, size);
+  }
+
+  if (allocator->resize != NULL) {
+    return allocator->resize(allocator->ctx, ptr, old_size, size);
+  }
+
+  void *p = allocator->alloc(allocator->ctx, size);
+  memcpy(p, ptr, old_size < size ? old_size : size);
+  if (allocator->release != NULL) {
+    allocator->release(allocator->ctx, ptr, old_size);
+  }
+
+  return p;
+}
+
+/**
+ * Free an allocation of `size` bytes made by `h_alloc`, `h_calloc` or
+ * `h_realloc`. `ptr` may be NULL. An allocator with no `release` keeps the
+ * memory until it frees it all at once itself.
+ *
+ * @param allocator
+ * @param ptr
+ * @param size
+ */
+static inline void h_free(const hash_allocator *allocator, void *ptr,
+                          const size_t size) {
+  if (allocator->alloc == NULL) {
+    free(ptr);
+  } else if (allocator->release != NULL && ptr != NULL) {
+    allocator->release(allocator->ctx, ptr, size);
+  }
+}
+
+#endif /* LIBHASH_ALLOC_H */
@@ -0,0 +1,58 @@
+#include "arena.h"
+
+#include "alloc.h"
+
+/**
+ * Allocate `size` bytes from the arena whose head chunk is `*arena`, starting
+ * a new chunk if the head does not have room. Allocations are not aligned, as
+ * only key bytes are stored in arenas.
+ *
+ * @param arena
+ * @param size
+ * @param allocator The allocator to allocate chunks with
+ * @return char*
+ */
+char *h_arena_alloc(struct h_arena_chunk **arena, const size_t size,
+                    const hash_allocator *allocator) {
+  struct h_arena_chunk *head = *arena;
+
+  if (head == NULL || head->size - head->used < size) {
+    size_t chunk_size = H_ARENA_CHUNK_SIZE;
+    if (head != NULL) {
+      chunk_size = head->size < H_ARENA_MAX_CHUNK_SIZE / 2
+                       ? head->size * 2
+                       : H_ARENA_MAX_CHUNK_SIZE;
+    }
+    if (chunk_size < size) {
+      chunk_size = size;
+    }
+
+    struct h_arena_chunk *chunk =
+        h_alloc(allocator, sizeof(struct h_arena_chunk) + chunk_size);
+    chunk->next = head;
+    chunk->size = chunk_size;
+    chunk->used = 0;
+
+    *arena = head = chunk;
+  }
+
+  char *p = head->data + head->used;
+  head->used += size;
+
+  return p;
+}
+
+/**
+ * Free every chunk of an arena.
+ *
+ * @param arena
+ * @param allocator The allocator the chunks were allocated with
+ */
+void h_arena_free(struct h_arena_chunk *arena,
+                  const hash_allocator *allocator) {
+  while (arena != NULL) {
+    struct h_arena_chunk *next = arena->next;
+    h_free(allocator, arena, sizeof(struct h_arena_chunk) + arena->size);
+    arena = next;
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef LIBHASH_ARENA_H
+#define LIBHASH_ARENA_H
+
+#include <stddef.h>
+
+#include "libhash.h"
+
+/**
+ * Size of a table's first arena chunk. Each subsequent chunk is twice the size
+ * of the last, up to H_ARENA_MAX_CHUNK_SIZE, so a table holding n bytes of keys
+ * needs O(log n) chunks until it reaches the cap, and O(n / cap) after.
+ */
+#define H_ARENA_CHUNK_SIZE 4096
+#define H_ARENA_MAX_CHUNK_SIZE (1u << 20)
+
+/**
+ * A chunk of a bump allocator. Allocations are carved from `data` in order;
+ * chunks are only ever freed all at once. The most recently allocated chunk is
+ * at the head of the list.
+ */
+struct h_arena_chunk {
+  struct h_arena_chunk *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+char *h_arena_alloc(struct h_arena_chunk **arena, const size_t size,
+                    const hash_allocator *allocator);
+void h_arena_free(struct h_arena_chunk *arena,
+                  const hash_allocator *allocator);
+
+#endif /* LIBHASH_ARENA_H */
@@ -0,0 +1,584 @@
+// pthread_rwlock_t is only declared by POSIX.1-2001 and later.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "group.h"
+#include "hash.h"
+#include "libhash.h"
+
+/**
+ * A lock stripe and the buckets it guards. Each stripe is aligned to a cache
+ * line of its own, so threads locking neighbouring stripes do not contend for
+ * the same line. Every field is only read under `lock`, and only written
+ * under it exclusively.
+ */
+struct ct_stripe {
+  _Alignas(H_CACHE_LINE) pthread_rwlock_t lock;
+
+  /**
+   * Number of buckets. Behind the table's stripe capacity until the stripe is
+   * migrated.
+   */
+  unsigned int capacity;
+
+  hash_reducer reducer;
+
+  /**
+   * Number of entries in the stripe
+   */
+  unsigned int count;
+
+  /**
+   * Number of buckets holding a deleted marker. See hash_table.deleted.
+   */
+  unsigned int deleted;
+
+  /**
+   * One control byte per bucket, plus a mirrored tail. See hash_table.ctrl.
+   */
+  uint8_t *ctrl;
+
+  /**
+   * The stripe's entries, indexed by bucket. This is also the allocation that
+   * `ctrl` points into.
+   */
+  ht_entry *entries;
+
+  /**
+   * Number of times the stripe has been rebuilt in place to clear its
+   * deleted markers
+   */
+  unsigned int purges;
+
+  /**
+   * The stripe's key arena, if the table has `arena_keys` set. Each stripe has
+   * its own so that inserts into different stripes need no shared state.
+   */
+  struct h_arena_chunk *arena;
+};
+
+/**
+ * How far the table has grown and how far its stripes have caught up, kept
+ * out of ct_table so that libhash.h declares no atomics of its own.
+ */
+struct ct_growth {
+  /**
+   * Number of buckets every stripe has, or will have once migrated. Only ever
+   * grows.
+   */
+  _Atomic unsigned int stripe_capacity;
+
+  /**
+   * The next stripe to claim for migrating to `stripe_capacity`, or
+   * `stripe_count` or more if there is none.
+   */
+  _Atomic unsigned int transfer_index;
+
+  /**
+   * Number of times the table has grown
+   */
+  _Atomic unsigned int resizes;
+};
+
+/**
+ * Size in bytes of a stripe's buckets allocation for a capacity: the entries,
+ * then the control bytes.
+ *
+ * @param capacity
+ * @return size_t
+ */
+static size_t ct_buckets_size(const unsigned int capacity) {
+  return (size_t)capacity * sizeof(ht_entry) + capacity + H_GROUP_WIDTH - 1;
+}
+
+/**
+ * The stripe a key belongs to. Stripes are picked by hash bits that neither
+ * the control tag nor the bucket index within a stripe depend on, so each
+ * stripe's buckets are filled as evenly as a whole table's would be.
+ *
+ * @param ct
+ * @param hash
+ * @return struct ct_stripe*
+ */
+static struct ct_stripe *ct_stripe_for(const ct_table *ct,
+                                       const uint64_t hash) {
+  return &ct->stripes[(hash >> 40) & (ct->stripe_count - 1)];
+}
+
+static bool ct_entry_matches(const ht_entry *r, const void *key,
+                             const size_t len, const uint64_t hash) {
+  return r->hash == hash && r->key_len == len && memcmp(r->key, key, len) == 0;
+}
+
+/**
+ * Find the bucket of `s` holding `key`. See `ht_find_bucket`. The stripe must
+ * be locked.
+ *
+ * @param s
+ * @param key
+ * @param len
+ * @param hash `h_hash` digest of `key`
+ * @return int The bucket, or -1 if the key is not present
+ */
+static int ct_find_bucket(const struct ct_stripe *s, const void *key,
+                          const size_t len, const uint64_t hash) {
+  const unsigned int capacity = s->capacity;
+  const uint8_t tag = h_ctrl_tag(hash);
+
+  h_group_probe probe;
+  unsigned int pos = h_group_probe_start(&probe, hash, capacity, &s->reducer);
+
+  for (unsigned int i = h_group_probe_limit(capacity); i > 0; i--) {
+    const h_group g = h_group_load(s->ctrl + pos);
+
+    h_bitmask match = h_group_match(g, tag);
+    while (match) {
+      const unsigned int idx =
+          h_group_bucket(pos, h_bitmask_next(&match), capacity);
+
+      if (ct_entry_matches(&s->entries[idx], key, len, hash)) {
+        return (int)idx;
+      }
+    }
+
+    if (h_group_match_empty(g)) {
+      break;
+    }
+
+    pos = h_group_probe_next(&probe);
+  }
+
+  return -1;
+}
+
+/**
+ * Place an entry whose key is not yet in the stripe. See `u64_place_entry`.
+ * The stripe must be locked exclusively.
+ *
+ * @param s
+ * @param r
+ */
+static void ct_place_entry(struct ct_stripe *s, const ht_entry *r) {
+  const unsigned int capacity = s->capacity;
+
+  h_group_probe probe;
+  unsigned int pos =
+      h_group_probe_start(&probe, r->hash, capacity, &s->reducer);
+
+  // The load limit guarantees a free bucket.
+  h_bitmask free_mask;
+  while (!(free_mask =
+               h_group_match_empty_or_deleted(h_group_load(s->ctrl + pos)))) {
+    pos = h_group_probe_next(&probe);
+  }
+
+  const unsigned int idx =
+      h_group_bucket(pos, h_bitmask_next(&free_mask), capacity);
+
+  if (s->ctrl[idx] == H_CTRL_DELETED) {
+    s->deleted--;
+  }
+
+  h_ctrl_set(s->ctrl, capacity, idx, h_ctrl_tag(r->hash));
+  s->entries[idx] = *r;
+}
+
+/**
+ * Allocate empty buckets for a stripe at the given capacity, rounded as
+ * `h_capacity` rounds it, replacing its current ones.
+ *
+ * @param ct
+ * @param s
+ * @param capacity
+ */
+static void ct_init_buckets(const ct_table *ct, struct ct_stripe *s,
+                            const unsigned int capacity) {
+  s->capacity = h_capacity((int)capacity, ct->opts.pow2_capacity, &s->reducer);
+  s->entries = h_alloc(&ct->opts.allocator, ct_buckets_size(s->capacity));
+  s->ctrl = (uint8_t *)s->entries + (size_t)s->capacity * sizeof(ht_entry);
+  memset(s->ctrl, H_CTRL_EMPTY, (size_t)s->capacity + H_GROUP_WIDTH - 1);
+  s->deleted = 0;
+}
+
+/**
+ * Re-place every entry of a stripe into new buckets at the given capacity,
+ * dropping its deleted markers. The stripe must be locked exclusively.
+ *
+ * @param ct
+ * @param s
+ * @param capacity
+ */
+static void ct_rebuild_stripe(const ct_table *ct, struct ct_stripe *s,
+                              const unsigned int capacity) {
+  ht_entry *old_entries = s->entries;
+  const uint8_t *old_ctrl = s->ctrl;
+  const unsigned int old_capacity = s->capacity;
+
+  ct_init_buckets(ct, s, capacity);
+
+  for (unsigned int pos = 0; pos < old_capacity; pos += H_GROUP_WIDTH) {
+    h_bitmask full = h_group_match_full(h_group_load(old_ctrl + pos));
+    if (old_capacity - pos < H_GROUP_WIDTH) {
+      full &= (1u << (old_capacity - pos)) - 1;
+    }
+
+    while (full) {
+      ct_place_entry(s, &old_entries[pos + h_bitmask_next(&full)]);
+    }
+  }
+
+  h_free(&ct->opts.allocator, old_entries, ct_buckets_size(old_capacity));
+}
+
+/**
+ * Migrate a stripe to the table's stripe capacity, if it has not been yet.
+ * The stripe must be locked exclusively.
+ *
+ * @param ct
+ * @param s
+ * @return bool Whether the stripe was migrated
+ */
+static bool ct_catch_up(const ct_table *ct, struct ct_stripe *s) {
+  const unsigned int capacity = atomic_load(&ct->growth->stripe_capacity);
+  if (s->capacity == capacity) {
+    return false;
+  }
+
+  ct_rebuild_stripe(ct, s, capacity);
+  return true;
+}
+
+/**
+ * Claim the next stripe left to migrate while the table grows, and migrate
+ * it. The caller must hold no stripe lock.
+ *
+ * @param ct
+ * @return int 1 if the stripe was migrated, 0 if another thread had already
+ * migrated it, or -1 if there was no stripe left to claim
+ */
+static int ct_transfer(ct_table *ct) {
+  // Checked first so that the index only ever overshoots the stripe count by
+  // the number of threads racing to claim the last stripe.
+  if (atomic_load(&ct->growth->transfer_index) >= ct->stripe_count) {
+    return -1;
+  }
+
+  const unsigned int i = atomic_fetch_add(&ct->growth->transfer_index, 1);
+  if (i >= ct->stripe_count) {
+    return -1;
+  }
+
+  struct ct_stripe *s = &ct->stripes[i];
+
+  pthread_rwlock_wrlock(&s->lock);
+  const bool migrated = ct_catch_up(ct, s);
+  pthread_rwlock_unlock(&s->lock);
+
+  return migrated;
+}
+
+/**
+ * Double the table's stripe capacity, then migrate stripes until none are
+ * left to claim. Threads that find their stripe full at the same time grow
+ * the table once between them, and all help migrate it. The caller must hold
+ * no stripe lock.
+ *
+ * @param ct
+ * @param seen_capacity The stripe capacity the caller found too small. If
+ * another thread has grown the table since, it only helps migrate it.
+ */
+static void ct_grow(ct_table *ct, unsigned int seen_capacity) {
+  hash_reducer reducer;
+  const unsigned int capacity =
+      h_capacity((int)seen_capacity * 2, ct->opts.pow2_capacity, &reducer);
+
+  if (atomic_compare_exchange_strong(&ct->growth->stripe_capacity,
+                                     &seen_capacity, capacity)) {
+    atomic_store(&ct->growth->transfer_index, 0);
+    atomic_fetch_add(&ct->growth->resizes, 1);
+  }
+
+  while (ct_transfer(ct) != -1) {
+  }
+}
+
+/**
+ * Delete an entry's key and value. See `ht_delete_entry`.
+ *
+ * @param ct
+ * @param r
+ */
+static void ct_delete_entry(const ct_table *ct, ht_entry *r) {
+  h_key_free(r->key, r->key_len, &ct->opts);
+  r->key = NULL;
+  if (ct->free_value && r->value) {
+    ct->free_value(r->value);
+    r->value = NULL;
+  }
+}
+
+/**
+ * Round a requested stripe count up to a power of two.
+ *
+ * @param stripes
+ * @return unsigned int
+ */
+static unsigned int ct_stripe_count(const unsigned int stripes) {
+  unsigned int count = 1;
+  while (count < (stripes ? stripes : CT_DEFAULT_STRIPES)) {
+    count <<= 1;
+  }
+
+  return count;
+}
+
+ct_table *ct_init(int base_capacity, free_fn *free_value) {
+  return ct_init_opts(base_capacity, free_value, NULL);
+}
+
+ct_table *ct_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts) {
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
+
+  ct_table *ct = h_alloc(&opts->allocator, sizeof(ct_table));
+  ct->opts = *opts;
+  ct->stripe_count = ct_stripe_count(opts->stripes);
+
+  // Group probing needs at least a group's worth of buckets per stripe.
+  base_capacity /= (int)ct->stripe_count;
+  if (base_capacity < H_GROUP_WIDTH) {
+    base_capacity = H_GROUP_WIDTH;
+  }
+
+  hash_reducer reducer;
+  const unsigned int capacity =
+      h_capacity(base_capacity, ct->opts.pow2_capacity, &reducer);
+
+  ct->growth = h_alloc(&ct->opts.allocator, sizeof(struct ct_growth));
+  atomic_init(&ct->growth->stripe_capacity, capacity);
+  atomic_init(&ct->growth->transfer_index, ct->stripe_count);
+  atomic_init(&ct->growth->resizes, 0);
+  ct->free_value = free_value;
+
+  ct->stripes_alloc =
+      h_alloc(&ct->opts.allocator,
+              ct->stripe_count * sizeof(struct ct_stripe) + H_CACHE_LINE - 1);
+  ct->stripes = h_cache_align(ct->stripes_alloc);
+
+  for (unsigned int i = 0; i < ct->stripe_count; i++) {
+    struct ct_stripe *s = &ct->stripes[i];
+
+    pthread_rwlock_init(&s->lock, NULL);
+    s->count = 0;
+    s->purges = 0;
+    s->arena = NULL;
+    ct_init_buckets(ct, s, capacity);
+  }
+
+  return ct;
+}
+
+void ct_insert(ct_table *ct, const char *key, void *value) {
+  ct_insert_n(ct, key, strlen(key), value);
+}
+
+void ct_insert_n(ct_table *ct, const void *key, size_t len, void *value) {
+  if (ct == NULL) {
+    return;
+  }
+
+  const uint64_t hash = h_hash(key, len);
+  struct ct_stripe *s = ct_stripe_for(ct, hash);
+
+  // Writers help a growing table along, one stripe each, as ConcurrentHashMap
+  // does. Readers do not, so lookups never wait on a migration but their own.
+  ct_transfer(ct);
+
+  for (;;) {
+    pthread_rwlock_wrlock(&s->lock);
+
+    // Entries are only ever added at the table's capacity, so the load limit
+    // below sees the capacity the stripe is growing to.
+    ct_catch_up(ct, s);
+
+    const unsigned int capacity = s->capacity;
+    const int idx = ct_find_bucket(s, key, len, hash);
+    if (idx != -1) {
+      ht_entry *r = &s->entries[idx];
+      if (ct->free_value && r->value && r->value != value) {
+        ct->free_value(r->value);
+      }
+      r->value = value;
+      break;
+    }
+
+    // The same growth and purge limits as hash_table; see `__ht_insert`.
+    // Growing migrates other stripes, so this one must be released first.
+    if (s->count * 100 / capacity > 70) {
+      pthread_rwlock_unlock(&s->lock);
+      ct_grow(ct, capacity);
+      continue;
+    }
+
+    if ((s->count + s->deleted) * 100 / capacity > 70 &&
+        s->deleted * 100 / capacity >= 15) {
+      ct_rebuild_stripe(ct, s, capacity);
+      s->purges++;
+    }
+
+    const ht_entry r = {.key = h_key_store(key, len, &ct->opts, &s->arena),
+                        .key_len = len,
+                        .value = value,
+                        .hash = hash};
+    ct_place_entry(s, &r);
+    s->count++;
+    break;
+  }
+
+  pthread_rwlock_unlock(&s->lock);
+}
+
+void *ct_get(ct_table *ct, const char *key) {
+  return ct_get_n(ct, key, strlen(key));
+}
+
+void *ct_get_n(ct_table *ct, const void *key, size_t len) {
+  const uint64_t hash = h_hash(key, len);
+  struct ct_stripe *s = ct_stripe_for(ct, hash);
+
+  pthread_rwlock_rdlock(&s->lock);
+
+  const int idx = ct_find_bucket(s, key, len, hash);
+  void *value = idx == -1 ? NULL : s->entries[idx].value;
+
+  pthread_rwlock_unlock(&s->lock);
+
+  return value;
+}
+
+int ct_delete(ct_table *ct, const char *key) {
+  return ct_delete_n(ct, key, strlen(key));
+}
+
+int ct_delete_n(ct_table *ct, const void *key, size_t len) {
+  const uint64_t hash = h_hash(key, len);
+  struct ct_stripe *s = ct_stripe_for(ct, hash);
+
+  ct_transfer(ct);
+
+  pthread_rwlock_wrlock(&s->lock);
+
+  const int idx = ct_find_bucket(s, key, len, hash);
+  if (idx != -1) {
+    ct_delete_entry(ct, &s->entries[idx]);
+    h_ctrl_set(s->ctrl, s->capacity, (unsigned int)idx, H_CTRL_DELETED);
+    s->deleted++;
+    s->count--;
+  }
+
+  pthread_rwlock_unlock(&s->lock);
+
+  return idx != -1;
+}
+
+unsigned int ct_count(ct_table *ct) {
+  unsigned int count = 0;
+
+  for (unsigned int i = 0; i < ct->stripe_count; i++) {
+    struct ct_stripe *s = &ct->stripes[i];
+
+    pthread_rwlock_rdlock(&s->lock);
+    count += s->count;
+    pthread_rwlock_unlock(&s->lock);
+  }
+
+  return count;
+}
+
+void ct_get_stats(ct_table *ct, ht_stats *stats) {
+  *stats = (ht_stats){.resizes = atomic_load(&ct->growth->resizes)};
+
+  unsigned long total_probe_groups = 0;
+
+  for (unsigned int i = 0; i < ct->stripe_count; i++) {
+    struct ct_stripe *s = &ct->stripes[i];
+
+    pthread_rwlock_rdlock(&s->lock);
+
+    stats->capacity += s->capacity;
+    stats->count += s->count;
+    stats->deleted += s->deleted;
+    stats->purges += s->purges;
+
+    for (unsigned int idx = 0; idx < s->capacity; idx++) {
+      if (!h_ctrl_is_full(s->ctrl[idx])) {
+        continue;
+      }
+
+      // See `ht_probe_group`.
+      h_group_probe probe;
+      const unsigned int start = h_group_probe_start(
+          &probe, s->entries[idx].hash, s->capacity, &s->reducer);
+      const unsigned int groups =
+          ((idx + s->capacity - start) % s->capacity) / H_GROUP_WIDTH + 1;
+
+      total_probe_groups += groups;
+      if (groups > stats->max_probe_groups) {
+        stats->max_probe_groups = groups;
+      }
+    }
+
+    pthread_rwlock_unlock(&s->lock);
+  }
+
+  stats->mean_probe_groups =
+      stats->count ? (double)total_probe_groups / stats->count : 0;
+}
+
+unsigned int ct_help_resize(ct_table *ct) {
+  unsigned int migrated = 0;
+
+  int r;
+  while ((r = ct_transfer(ct)) != -1) {
+    migrated += (unsigned int)r;
+  }
+
+  return migrated;
+}
+
+void ct_delete_table(ct_table *ct) {
+  const hash_allocator allocator = ct->opts.allocator;
+
+  for (unsigned int i = 0; i < ct->stripe_count; i++) {
+    struct ct_stripe *s = &ct->stripes[i];
+    const unsigned int capacity = s->capacity;
+
+    // Borrowed and arena keys need no freeing one by one, so unless there are
+    // values to free there is nothing to visit the entries for.
+    if (h_key_owned(&ct->opts) || ct->free_value) {
+      for (unsigned int idx = 0; idx < capacity; idx++) {
+        if (h_ctrl_is_full(s->ctrl[idx])) {
+          ct_delete_entry(ct, &s->entries[idx]);
+        }
+      }
+    }
+
+    h_arena_free(s->arena, &allocator);
+    h_free(&allocator, s->entries, ct_buckets_size(capacity));
+    pthread_rwlock_destroy(&s->lock);
+  }
+
+  h_free(&allocator, ct->stripes_alloc,
+         ct->stripe_count * sizeof(struct ct_stripe) + H_CACHE_LINE - 1);
+  h_free(&allocator, ct->growth, sizeof(struct ct_growth));
+  h_free(&allocator, ct, sizeof(ct_table));
+}
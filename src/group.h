@@ -0,0 +1,222 @@
+#ifndef LIBHASH_GROUP_H
+#define LIBHASH_GROUP_H
+
+#include <stdint.h>
+
+#include "hash.h"
+
+#if defined(__SSE2__) && !defined(LIBHASH_NO_SSE2)
+#include <emmintrin.h>
+#define H_GROUP_SSE2 1
+#endif
+
+/**
+ * Control bytes. Every bucket has one: either one of the two special states
+ * below (both have the high bit set), or - for an occupied bucket - the low 7
+ * bits of its key's hash (high bit clear). Scanning these 16 at a time lets
+ * most probes reject every bucket in a group without reading the buckets.
+ */
+#define H_CTRL_EMPTY ((uint8_t)0x80)
+#define H_CTRL_DELETED ((uint8_t)0xFE)
+
+/**
+ * Number of control bytes matched at once. The control array is allocated
+ * with H_GROUP_WIDTH - 1 trailing bytes that mirror the first control bytes,
+ * so a group may be loaded starting at any bucket without wrapping.
+ */
+#define H_GROUP_WIDTH 16
+
+/**
+ * A bitmask with one bit per control byte in a group; bit i is set if byte i
+ * matched.
+ */
+typedef uint32_t h_bitmask;
+
+#ifdef H_GROUP_SSE2
+typedef __m128i h_group;
+#else
+typedef struct {
+  uint8_t ctrl[H_GROUP_WIDTH];
+} h_group;
+#endif
+
+/**
+ * An in-progress probe over groups of control bytes. See
+ * `h_group_probe_start`.
+ */
+typedef struct {
+  unsigned int pos;
+  unsigned int capacity;
+} h_group_probe;
+
+/**
+ * The control byte stored for an occupied bucket whose key hashes to `hash`.
+ *
+ * @param hash
+ * @return uint8_t
+ */
+static inline uint8_t h_ctrl_tag(const uint64_t hash) {
+  return (uint8_t)(hash & 0x7F);
+}
+
+/**
+ * Whether the given control byte marks an occupied bucket.
+ *
+ * @param ctrl
+ * @return int
+ */
+static inline int h_ctrl_is_full(const uint8_t ctrl) {
+  return (ctrl & 0x80) == 0;
+}
+
+/**
+ * Set the control byte for bucket `idx`, keeping the mirrored tail in sync.
+ *
+ * @param ctrl
+ * @param capacity
+ * @param idx
+ * @param tag
+ */
+static inline void h_ctrl_set(uint8_t *ctrl, const unsigned int capacity,
+                              const unsigned int idx, const uint8_t tag) {
+  ctrl[idx] = tag;
+  if (idx < H_GROUP_WIDTH - 1) {
+    ctrl[capacity + idx] = tag;
+  }
+}
+
+static inline h_group h_group_load(const uint8_t *ctrl) {
+#ifdef H_GROUP_SSE2
+  return _mm_loadu_si128((const __m128i *)ctrl);
+#else
+  h_group g;
+  for (unsigned int i = 0; i < H_GROUP_WIDTH; i++) {
+    g.ctrl[i] = ctrl[i];
+  }
+  return g;
+#endif
+}
+
+/**
+ * Match every control byte in the group equal to `tag`.
+ *
+ * @param g
+ * @param tag
+ * @return h_bitmask
+ */
+static inline h_bitmask h_group_match(const h_group g, const uint8_t tag) {
+#ifdef H_GROUP_SSE2
+  return (h_bitmask)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(g, _mm_set1_epi8((char)tag)));
+#else
+  h_bitmask mask = 0;
+  for (unsigned int i = 0; i < H_GROUP_WIDTH; i++) {
+    mask |= (h_bitmask)(g.ctrl[i] == tag) << i;
+  }
+  return mask;
+#endif
+}
+
+static inline h_bitmask h_group_match_empty(const h_group g) {
+  return h_group_match(g, H_CTRL_EMPTY);
+}
+
+/**
+ * Match every control byte in the group that is not occupied. Both special
+ * states have the high bit set, so this is a single movemask.
+ *
+ * @param g
+ * @return h_bitmask
+ */
+static inline h_bitmask h_group_match_empty_or_deleted(const h_group g) {
+#ifdef H_GROUP_SSE2
+  return (h_bitmask)_mm_movemask_epi8(g);
+#else
+  h_bitmask mask = 0;
+  for (unsigned int i = 0; i < H_GROUP_WIDTH; i++) {
+    mask |= (h_bitmask)(!h_ctrl_is_full(g.ctrl[i])) << i;
+  }
+  return mask;
+#endif
+}
+
+/**
+ * Match every occupied control byte in the group.
+ *
+ * @param g
+ * @return h_bitmask
+ */
+static inline h_bitmask h_group_match_full(const h_group g) {
+  return ~h_group_match_empty_or_deleted(g) & ((1u << H_GROUP_WIDTH) - 1);
+}
+
+/**
+ * Pop the lowest set bit from `mask`, returning its position.
+ *
+ * @param mask
+ * @return unsigned int
+ */
+static inline unsigned int h_bitmask_next(h_bitmask *mask) {
+#if defined(__GNUC__) || defined(__clang__)
+  const unsigned int i = (unsigned int)__builtin_ctz(*mask);
+#else
+  unsigned int i = 0;
+  while (!((*mask >> i) & 1)) {
+    i++;
+  }
+#endif
+  *mask &= *mask - 1;
+  return i;
+}
+
+/**
+ * Begin a probe over groups for the given hash. The starting bucket is taken
+ * from the hash bits above the control tag (see `h_reduce`), and each
+ * subsequent group starts H_GROUP_WIDTH buckets later, wrapping at the
+ * capacity. After `h_group_probe_limit` groups every bucket has been visited.
+ *
+ * @param probe
+ * @param hash
+ * @param capacity Must be at least H_GROUP_WIDTH
+ * @param reducer See `h_capacity`
+ * @return unsigned int The first bucket of the first group
+ */
+static inline unsigned int h_group_probe_start(h_group_probe *probe,
+                                               const uint64_t hash,
+                                               const unsigned int capacity,
+                                               const hash_reducer *reducer) {
+  probe->pos = h_reduce(hash >> 7, capacity, reducer);
+  probe->capacity = capacity;
+
+  return probe->pos;
+}
+
+static inline unsigned int h_group_probe_next(h_group_probe *probe) {
+  probe->pos += H_GROUP_WIDTH;
+  if (probe->pos >= probe->capacity) {
+    probe->pos -= probe->capacity;
+  }
+
+  return probe->pos;
+}
+
+static inline unsigned int h_group_probe_limit(const unsigned int capacity) {
+  return (capacity + H_GROUP_WIDTH - 1) / H_GROUP_WIDTH;
+}
+
+/**
+ * Resolve the bucket index of bit `bit` in the group starting at `pos`.
+ *
+ * @param pos
+ * @param bit
+ * @param capacity
+ * @return unsigned int
+ */
+static inline unsigned int h_group_bucket(const unsigned int pos,
+                                          const unsigned int bit,
+                                          const unsigned int capacity) {
+  const unsigned int idx = pos + bit;
+  return idx >= capacity ? idx - capacity : idx;
+}
+
+#endif /* LIBHASH_GROUP_H */
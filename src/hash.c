@@ -1,59 +1,223 @@
 #include "hash.h"
 
-#include <math.h>    // for pow
-#include <string.h>  // for strlen
+#include <string.h>  // for memcpy
 
-static const int H_PRIME_1 = 157;
-static const int H_PRIME_2 = 163;
+#include "prime.h"
 
 /**
- * Hash a given ASCII key, where `prime` is a prime number
- * larger than 128 (ASCII alphabet max)
+ * Default seed and secret constants, taken from wyhash (public domain). Each
+ * secret is an odd 64-bit value with 32 set bits, which keeps the multiply-mix
+ * below well distributed.
+ */
+static const uint64_t H_SEED = 0x243f6a8885a308d3ull;
+static const uint64_t H_SECRET[4] = {
+    0xa0761d6478bd642full,
+    0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull,
+};
+
+/**
+ * Multiply two 64-bit integers into a 128-bit product, storing the low half in
+ * `a` and the high half in `b`.
+ *
+ * @param a
+ * @param b
+ */
+static inline void h_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+  __extension__ typedef unsigned __int128 h_u128;
+
+  const h_u128 r = (h_u128)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+#else
+  const uint64_t ha = *a >> 32, hb = *b >> 32;
+  const uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+  const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  const uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/**
+ * Fold the 128-bit product of `a` and `b` down to 64 bits.
+ *
+ * @param a
+ * @param b
+ * @return uint64_t
+ */
+static inline uint64_t h_mix(uint64_t a, uint64_t b) {
+  h_mum(&a, &b);
+  return a ^ b;
+}
+
+/**
+ * Unaligned loads. These read in host byte order; hashes are only ever
+ * compared within a single process so we do not need to normalize endianness.
+ */
+static inline uint64_t h_read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t h_read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * Read 1 to 3 bytes without branching on the exact length.
+ *
+ * @param p
+ * @param len
+ * @return uint64_t
+ */
+static inline uint64_t h_read_small(const uint8_t *p, size_t len) {
+  return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+/**
+ * Hash `len` bytes of `key` into a 64-bit digest. This is a wyhash-style
+ * function: the input is consumed 8 bytes at a time (48 bytes per iteration
+ * for long keys, across three independent lanes) and each pair of words is
+ * folded with a 64x64->128 bit multiply. Keys of 16 bytes or fewer are read
+ * with at most four overlapping loads and no loop at all.
  *
  * @param key
- * @param prime
- * @param capacity
+ * @param len
+ * @return uint64_t
+ */
+uint64_t h_hash(const void *key, size_t len) {
+  const uint8_t *p = (const uint8_t *)key;
+  uint64_t seed = H_SEED ^ h_mix(H_SEED ^ H_SECRET[0], H_SECRET[1]);
+  uint64_t a, b;
+
+  if (len <= 16) {
+    if (len >= 4) {
+      const size_t off = (len >> 3) << 2;
+      a = (h_read32(p) << 32) | h_read32(p + off);
+      b = (h_read32(p + len - 4) << 32) | h_read32(p + len - 4 - off);
+    } else if (len > 0) {
+      a = h_read_small(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+
+    if (i > 48) {
+      uint64_t seed1 = seed, seed2 = seed;
+      do {
+        seed = h_mix(h_read64(p) ^ H_SECRET[1], h_read64(p + 8) ^ seed);
+        seed1 =
+            h_mix(h_read64(p + 16) ^ H_SECRET[2], h_read64(p + 24) ^ seed1);
+        seed2 =
+            h_mix(h_read64(p + 32) ^ H_SECRET[3], h_read64(p + 40) ^ seed2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= seed1 ^ seed2;
+    }
+
+    while (i > 16) {
+      seed = h_mix(h_read64(p) ^ H_SECRET[1], h_read64(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+
+    // The final 16 bytes may overlap with bytes we've already consumed.
+    a = h_read64(p + i - 16);
+    b = h_read64(p + i - 8);
+  }
+
+  a ^= H_SECRET[1];
+  b ^= seed;
+  h_mum(&a, &b);
+
+  return h_mix(a ^ H_SECRET[0] ^ len, b ^ H_SECRET[1]);
+}
+
+/**
+ * Resolve the capacity for the given base capacity: the first growth prime at
+ * or above it (see `prime_ladder_ceil`) or, if `pow2` is set, the first power
+ * of two. `reducer` is set up for `h_reduce` to map hashes onto that capacity.
+ *
+ * @param base_capacity
+ * @param pow2
+ * @param reducer
  * @return unsigned int
  */
-static unsigned int h_hash(const char *key, const int prime,
-                           const int capacity) {
-  long hash = 0;
+unsigned int h_capacity(const int base_capacity, const bool pow2,
+                        hash_reducer *reducer) {
+  if (!pow2) {
+    const prime_rung *rung = prime_ladder_ceil((unsigned int)base_capacity);
+
+    reducer->magic = rung->magic;
+    reducer->shift = 0;
+    return rung->prime;
+  }
 
-  const size_t len_s = strlen(key);
-  for (unsigned int i = 0; i < len_s; i++) {
-    // convert the key to a large integer
-    hash += (long)pow(prime, len_s - (i + 1)) * key[i];
-    // reduce said large integer to a fixed range
-    hash = hash % capacity;
+  // A capacity of 1 would need a shift by the full width of the hash.
+  unsigned int capacity = 2;
+  unsigned int bits = 1;
+  while (capacity < (unsigned int)base_capacity) {
+    capacity <<= 1;
+    bits++;
   }
 
-  return (unsigned int)hash;
+  reducer->magic = 0;
+  reducer->shift = 64 - bits;
+  return capacity;
 }
 
 /**
- * Resolve a hash from the given key, using open addressed
- * double-hashing. This method is adjusted contingent on the number of attempts
- * to resolve a hash without a collision. If no collisions have occurred, i == 0
- * and we resolve to `hash_a`. If a collision occurs, we modify the hash with
- * `hash_b`. Finally, if `hash_b` returns 0, the second term is reduced to 0,
- * causing the table to attempt inserting into the same index indefinitely. We
- * mitigate this behavior by adding 1 to the result of `hash_b`, ensuring it is
- * never 0.
+ * Begin an open addressed, double-hashed probe sequence for the given hash.
+ * The sequence is `hash_a + attempt * hash_b (mod capacity)`: if no collisions
+ * have occurred we resolve to `hash_a`, and each collision steps us forward by
+ * `hash_b`. Both are derived from a single `h_hash` digest via `h_reduce`:
+ * `hash_a` from the whole value and `hash_b` from its upper half. If `hash_b`
+ * were 0 the table would attempt the same index indefinitely, so we bump it to
+ * 1 in that case. For a power-of-two capacity `hash_b` is instead masked and
+ * forced odd, which keeps it coprime with the capacity. No division is
+ * performed in either case.
  *
- * @param key
+ * Because the key is hashed once up front and each subsequent slot is an add
+ * and a conditional subtract (see `h_probe_next`), the cost of a lookup no
+ * longer grows with key length times the number of probes.
+ *
+ * @param probe
+ * @param hash The key's digest, as produced by `h_hash`
  * @param capacity
- * @param attempt Number of attempts made to generate a non-colliding hash.
- * @return unsigned int
+ * @param reducer See `h_capacity`
+ * @return unsigned int The first index in the sequence
  */
-unsigned int h_compute_hash(const char *key, const int capacity,
-                            const int attempt) {
-  const unsigned int hash_a = h_hash(key, H_PRIME_1, capacity);
-  unsigned int hash_b = h_hash(key, H_PRIME_2, capacity);
+unsigned int h_probe_start(h_probe *probe, const uint64_t hash,
+                           const unsigned int capacity,
+                           const hash_reducer *reducer) {
+  unsigned int hash_b;
 
-  // Prevent infinite cycling when hash_b == num capacity.
-  if (hash_b % capacity == 0) {
-    hash_b = 1;
+  if (reducer->shift) {
+    hash_b = ((unsigned int)(hash >> 32) & (capacity - 1)) | 1;
+  } else {
+    hash_b = h_reduce(hash >> 32, capacity, reducer);
+
+    // Prevent infinite cycling when hash_b == num capacity.
+    if (hash_b == 0) {
+      hash_b = 1;
+    }
   }
 
-  return (hash_a + (attempt * hash_b)) % capacity;
+  probe->idx = h_reduce(hash, capacity, reducer);
+  probe->step = hash_b;
+  probe->capacity = capacity;
+
+  return probe->idx;
 }
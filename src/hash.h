@@ -1,7 +1,173 @@
 #ifndef LIBHASH_HASH_H
 #define LIBHASH_HASH_H
 
-unsigned int h_compute_hash(const char *key, const int capacity,
-                            const int attempt);
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "arena.h"
+#include "libhash.h"
+
+/**
+ * An in-progress probe sequence. See `h_probe_start`.
+ */
+typedef struct {
+  unsigned int idx;
+  unsigned int step;
+  unsigned int capacity;
+} h_probe;
+
+/**
+ * 2^64 divided by the golden ratio. Multiplying by this scatters every input
+ * bit into the high bits of the product; see `h_reduce`.
+ */
+#define H_FIBONACCI 0x9e3779b97f4a7c15ull
+
+uint64_t h_hash(const void *key, size_t len);
+
+static inline uint64_t h_hash_str(const char *key) {
+  return h_hash(key, strlen(key));
+}
+
+/**
+ * Hash a 64-bit integer key. This is the splitmix64 finalizer: each step is
+ * either an xorshift or a multiply by an odd constant, both of which are
+ * invertible, so distinct keys always get distinct hashes, while every key
+ * bit still reaches both the control tag and the bucket bits.
+ *
+ * @param key
+ * @return uint64_t
+ */
+static inline uint64_t h_hash_u64(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ull;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebull;
+  key ^= key >> 31;
+  return key;
+}
+
+/**
+ * Copy the `len` bytes of `key` into `dst`, adding a NUL terminator so keys
+ * inserted as strings can still be read back as strings.
+ *
+ * @param dst `len` + 1 bytes
+ * @param key
+ * @param len
+ * @return char* `dst`
+ */
+static inline char *h_key_copy(char *dst, const void *key, const size_t len) {
+  memcpy(dst, key, len);
+  dst[len] = '\0';
+  return dst;
+}
+
+/**
+ * Whether keys stored with the given settings are individually allocated, and
+ * so must be freed one by one.
+ *
+ * @param opts
+ * @return bool
+ */
+static inline bool h_key_owned(const hash_opts *opts) {
+  return !opts->borrow_keys && !opts->arena_keys;
+}
+
+/**
+ * Store a key in a table according to its settings: the caller's own pointer
+ * (see hash_opts.borrow_keys), a copy carved from the table's arena (see
+ * hash_opts.arena_keys), or else a copy in an allocation of its own.
+ *
+ * @param key
+ * @param len
+ * @param opts
+ * @param arena The table's arena
+ * @return char*
+ */
+static inline char *h_key_store(const void *key, const size_t len,
+                                const hash_opts *opts,
+                                struct h_arena_chunk **arena) {
+  if (opts->borrow_keys) {
+    return (char *)key;
+  }
+
+  if (opts->arena_keys) {
+    return h_key_copy(h_arena_alloc(arena, len + 1, &opts->allocator), key,
+                      len);
+  }
+
+  return h_key_copy(h_alloc(&opts->allocator, len + 1), key, len);
+}
+
+/**
+ * Free a key stored with `h_key_store`, if it has an allocation of its own.
+ *
+ * @param key
+ * @param len
+ * @param opts
+ */
+static inline void h_key_free(char *key, const size_t len,
+                              const hash_opts *opts) {
+  if (h_key_owned(opts)) {
+    h_free(&opts->allocator, key, len + 1);
+  }
+}
+
+unsigned int h_capacity(const int base_capacity, const bool pow2,
+                        hash_reducer *reducer);
+
+/**
+ * Map a hash onto an index below `capacity`, as set up by `h_capacity`.
+ *
+ * For a power-of-two capacity this is a Fibonacci multiply-shift: the top bits
+ * of `hash * H_FIBONACCI`.
+ *
+ * For a prime capacity this is Lemire's fastmod of the low 32 bits of the
+ * hash: multiplying by the precomputed reciprocal leaves the fractional part
+ * of `hash / capacity` in the low 64 bits, and multiplying that by the
+ * capacity brings the remainder into the high bits. The 64x32 high multiply
+ * is split into two 32x32 products so no 128-bit type is needed.
+ *
+ * Neither performs a division.
+ *
+ * @param hash
+ * @param capacity
+ * @param reducer
+ * @return unsigned int
+ */
+static inline unsigned int h_reduce(const uint64_t hash,
+                                    const unsigned int capacity,
+                                    const hash_reducer *reducer) {
+  if (reducer->shift) {
+    return (unsigned int)((hash * H_FIBONACCI) >> reducer->shift);
+  }
+
+  const uint64_t frac = reducer->magic * (uint32_t)hash;
+  return (unsigned int)(((frac >> 32) * capacity +
+                         (((frac & 0xFFFFFFFF) * capacity) >> 32)) >>
+                        32);
+}
+
+unsigned int h_probe_start(h_probe *probe, const uint64_t hash,
+                           const unsigned int capacity,
+                           const hash_reducer *reducer);
+
+/**
+ * Advance the probe sequence to the next candidate index.
+ *
+ * @param probe
+ * @return unsigned int
+ */
+static inline unsigned int h_probe_next(h_probe *probe) {
+  probe->idx += probe->step;
+  if (probe->idx >= probe->capacity) {
+    probe->idx -= probe->capacity;
+  }
+
+  return probe->idx;
+}
 
 #endif /* LIBHASH_HASH_H */
@@ -1,55 +1,123 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "hash.h"
 #include "libhash.h"
-#include "prime.h"
-#include "strdup/strdup.h"
+
+/**
+ * `key_len` of a slot whose key was deleted. See hs_entry.
+ */
+#define HS_DELETED_LEN SIZE_MAX
+
+static inline bool hs_slot_is_deleted(const hs_entry *r) {
+  return r->key == NULL && r->key_len == HS_DELETED_LEN;
+}
+
+/**
+ * Determine whether the given slot holds `key`. The cached hashes and then the
+ * lengths are compared first so that mismatched slots are rejected without
+ * touching the key bytes.
+ *
+ * @param r
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @return int
+ */
+static inline int hs_entry_matches(const hs_entry *r, const void *key,
+                                   const size_t len, const uint64_t hash) {
+  return r->hash == hash && r->key_len == len &&
+         memcmp(r->key, key, len) == 0;
+}
+
+/**
+ * Find the slot holding `key`. Deleted slots do not end the search, since the
+ * key may have been placed beyond one before it was deleted; only an empty
+ * slot or a full cycle of the probe sequence does.
+ *
+ * @param hs
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @return int The slot, or -1 if the key is not present
+ */
+static int hs_find_slot(const hash_set *hs, const void *key, const size_t len,
+                        const uint64_t hash) {
+  h_probe probe;
+  unsigned int idx = h_probe_start(&probe, hash, hs->capacity, &hs->reducer);
+
+  for (unsigned int i = 0; i < hs->capacity; i++) {
+    const hs_entry *r = &hs->entries[idx];
+
+    if (r->key == NULL && !hs_slot_is_deleted(r)) {
+      break;
+    }
+
+    if (r->key != NULL && hs_entry_matches(r, key, len, hash)) {
+      return (int)idx;
+    }
+
+    idx = h_probe_next(&probe);
+  }
+
+  return -1;
+}
 
 /**
  * Resize the hash set. This implementation has a set capacity;
  * hash collisions rise beyond the capacity and `hs_insert` will fail.
  * To mitigate this, we resize up if the load (measured as the ratio of keys
  * count to capacity) is less than .1, or down if the load exceeds .7. To
- * resize, we create a new set approx. 1/2x or 2x times the current set
- * size, then insert into it all non-deleted keys.
+ * resize, we allocate slots for a set approx. 1/2x or 2x times the current
+ * set size, then move into it all non-deleted keys by their cached hash.
  *
  * @param hs
  * @param base_capacity
  * @return int
  */
-static void hs_resize(hash_set *hs, const int base_capacity) {
+static void hs_resize(hash_set *hs, int base_capacity) {
   if (base_capacity < 0) {
     return;
   }
 
-  hash_set *new_hs = hs_init(base_capacity);
+  if (!base_capacity) {
+    base_capacity = HS_DEFAULT_CAPACITY;
+  }
 
-  for (unsigned int i = 0; i < hs->capacity; i++) {
-    const char *r = hs->keys[i];
+  hash_reducer reducer;
+  const unsigned int capacity =
+      h_capacity(base_capacity, hs->opts.pow2_capacity, &reducer);
+  hs_entry *entries =
+      h_calloc(&hs->opts.allocator, (size_t)capacity, sizeof(hs_entry));
 
-    if (r != NULL) {
-      hs_insert(new_hs, r);
-    }
-  }
+  for (unsigned int i = 0; i < hs->capacity; i++) {
+    const hs_entry *r = &hs->entries[i];
 
-  hs->base_capacity = new_hs->base_capacity;
-  hs->count = new_hs->count;
+    if (r->key != NULL) {
+      h_probe probe;
+      unsigned int idx = h_probe_start(&probe, r->hash, capacity, &reducer);
 
-  const unsigned int tmp_capacity = hs->capacity;
-  hs->capacity = new_hs->capacity;
-  new_hs->capacity = tmp_capacity;
+      while (entries[idx].key != NULL) {
+        idx = h_probe_next(&probe);
+      }
 
-  char **tmp_keys = hs->keys;
-  hs->keys = new_hs->keys;
-  new_hs->keys = tmp_keys;
+      entries[idx] = *r;
+    }
+  }
 
-  hs_delete_set(new_hs);
+  h_free(&hs->opts.allocator, hs->entries,
+         (size_t)hs->capacity * sizeof(hs_entry));
+  hs->entries = entries;
+  hs->capacity = capacity;
+  hs->reducer = reducer;
+  hs->base_capacity = base_capacity;
+  hs->deleted = 0;
 }
 
 /**
- * Resize the set to a larger size, the first prime subsequent
- * to approx. 2x the base capacity.
+ * Resize the set to a larger size, the first growth prime (or power of
+ * two) at or above approx. 2x the base capacity.
  *
  * @param hs
  */
@@ -59,8 +127,8 @@ static void hs_resize_up(hash_set *hs) {
 }
 
 /**
- * Resize the set to a smaller size, the first prime subsequent
- * to approx. 1/2x the base capacity.
+ * Resize the set to a smaller size, the first growth prime (or power of
+ * two) at or above approx. 1/2x the base capacity.
  *
  * @param hs
  */
@@ -70,121 +138,141 @@ static void hs_resize_down(hash_set *hs) {
 }
 
 /**
- * Delete a key and deallocate its memory
+ * Delete a key and deallocate its memory, if it has an allocation of its own
  *
- * @param r key to delete
+ * @param hs
+ * @param r entry whose key to delete
  */
-static void hs_delete_key(char *r) { free(r); }
+static void hs_delete_key(const hash_set *hs, const hs_entry *r) {
+  h_key_free(r->key, r->key_len, &hs->opts);
+}
 
 hash_set *hs_init(int base_capacity) {
+  return hs_init_opts(base_capacity, NULL);
+}
+
+hash_set *hs_init_opts(int base_capacity, const hash_opts *opts) {
   if (!base_capacity) {
     base_capacity = HS_DEFAULT_CAPACITY;
   }
 
-  hash_set *hs = malloc(sizeof(hash_set));
-  hs->base_capacity = base_capacity;
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
 
-  hs->capacity = next_prime(hs->base_capacity);
+  hash_set *hs = h_alloc(&opts->allocator, sizeof(hash_set));
+  hs->opts = *opts;
+
+  hs->base_capacity = base_capacity;
+  hs->capacity = h_capacity(hs->base_capacity, hs->opts.pow2_capacity,
+                            &hs->reducer);
   hs->count = 0;
-  hs->keys = calloc((size_t)hs->capacity, sizeof(char *));
+  hs->deleted = 0;
+  hs->entries =
+      h_calloc(&hs->opts.allocator, (size_t)hs->capacity, sizeof(hs_entry));
+  hs->arena = NULL;
 
   return hs;
 }
 
 void hs_insert(hash_set *hs, const void *key) {
+  hs_insert_n(hs, key, strlen(key));
+}
+
+void hs_insert_n(hash_set *hs, const void *key, size_t len) {
   if (hs == NULL) {
     return;
   }
 
+  const uint64_t hash = h_hash(key, len);
+  if (hs_find_slot(hs, key, len, hash) != -1) {
+    return;
+  }
+
+  // Deleted slots count towards the load, as they lengthen probes all the
+  // same. When they alone push it past the limit, rehash in place to clear
+  // them. See `__ht_insert`.
   const unsigned int load = hs->count * 100 / hs->capacity;
   if (load > 70) {
     hs_resize_up(hs);
+  } else if ((hs->count + hs->deleted) * 100 / hs->capacity > 70) {
+    hs_resize(hs, (int)hs->base_capacity);
   }
 
-  void *new_entry = strdup(key);
+  h_probe probe;
+  unsigned int idx = h_probe_start(&probe, hash, hs->capacity, &hs->reducer);
+  hs_entry *current_entry = &hs->entries[idx];
 
-  unsigned int idx = h_compute_hash(key, hs->capacity, 0);
-  char *current_key = hs->keys[idx];
-
-  unsigned int i = 1;
-  // If there was a collision...
-  while (current_key != NULL) {
-    // Key already exists (update)
-    if (strcmp(current_key, key) == 0) {
-      return;
-    }
+  // The key is not present, so the first deleted or empty slot will do.
+  while (current_entry->key != NULL) {
+    idx = h_probe_next(&probe);
+    current_entry = &hs->entries[idx];
+  }
 
-    idx = h_compute_hash(new_entry, hs->capacity, i);
-    current_key = hs->keys[idx];
-    i++;
+  if (hs_slot_is_deleted(current_entry)) {
+    hs->deleted--;
   }
 
-  hs->keys[idx] = new_entry;
+  current_entry->key = h_key_store(key, len, &hs->opts, &hs->arena);
+  current_entry->key_len = len;
+  current_entry->hash = hash;
   hs->count++;
 }
 
 int hs_contains(hash_set *hs, const char *key) {
-  unsigned int idx = h_compute_hash(key, hs->capacity, 0);
-  char *current_key = hs->keys[idx];
-
-  unsigned int i = 1;
-  while (current_key != NULL) {
-    if (strcmp(current_key, key) == 0) {
-      return 1;
-    }
-
-    idx = h_compute_hash(key, hs->capacity, i);
-    current_key = hs->keys[idx];
-    i++;
-
-    // If the capacity was set to the exact number of keys, we need to break
-    // once we've checked all of them - there won't be any NULL keys
-    if (i == hs->count + 1) {
-      break;
-    }
-  }
+  return hs_contains_n(hs, key, strlen(key));
+}
 
-  return 0;
+int hs_contains_n(hash_set *hs, const void *key, size_t len) {
+  return hs_find_slot(hs, key, len, h_hash(key, len)) != -1;
 }
 
 void hs_delete_set(hash_set *hs) {
-  for (unsigned int i = 0; i < hs->capacity; i++) {
-    char *r = hs->keys[i];
-
-    if (r != NULL) {
-      hs_delete_key(r);
+  // Borrowed and arena keys need no freeing one by one.
+  if (h_key_owned(&hs->opts)) {
+    for (unsigned int i = 0; i < hs->capacity; i++) {
+      const hs_entry *r = &hs->entries[i];
+
+      if (r->key != NULL) {
+        hs_delete_key(hs, r);
+      }
     }
   }
 
-  free(hs->keys);
-  free(hs);
+  // The set itself was allocated with the allocator it holds.
+  const hash_allocator allocator = hs->opts.allocator;
+
+  h_arena_free(hs->arena, &allocator);
+  h_free(&allocator, hs->entries, (size_t)hs->capacity * sizeof(hs_entry));
+  h_free(&allocator, hs, sizeof(hash_set));
 }
 
 int hs_delete(hash_set *hs, const char *key) {
+  return hs_delete_n(hs, key, strlen(key));
+}
+
+int hs_delete_n(hash_set *hs, const void *key, size_t len) {
   const unsigned int load = hs->count * 100 / hs->capacity;
 
   if (load < 10) {
     hs_resize_down(hs);
   }
 
-  unsigned int i = 0;
-  unsigned int idx = h_compute_hash(key, hs->capacity, i);
-
-  char *current_key = hs->keys[idx];
-
-  while (current_key != NULL) {
-    if (strcmp(current_key, key) == 0) {
-      hs_delete_key(current_key);
-      hs->keys[idx] = NULL;
-
-      hs->count--;
+  const int idx = hs_find_slot(hs, key, len, h_hash(key, len));
+  if (idx == -1) {
+    return 0;
+  }
 
-      return 1;
-    }
+  // Mark the slot deleted rather than empty, so that probes for keys placed
+  // beyond it still reach them.
+  hs_entry *r = &hs->entries[idx];
+  hs_delete_key(hs, r);
+  r->key = NULL;
+  r->key_len = HS_DELETED_LEN;
 
-    idx = h_compute_hash(key, hs->capacity, ++i);
-    current_key = hs->keys[idx];
-  }
+  hs->count--;
+  hs->deleted++;
 
-  return 0;
+  return 1;
 }
@@ -2,24 +2,254 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hash_table.h"
+
+#include "group.h"
 #include "hash.h"
 #include "libhash.h"
-#include "prime.h"
-#include "strdup/strdup.h"
 
-static ht_entry HT_SENTINEL_ENTRY = {NULL, NULL};
+// Group loads may start at any bucket, so the table must span at least one.
+_Static_assert(HT_DEFAULT_CAPACITY >= H_GROUP_WIDTH,
+               "HT_DEFAULT_CAPACITY must be at least one control group wide");
 
-static void __ht_insert(hash_table *ht, const char *key, void *value);
-static int __ht_delete(hash_table *ht, const char *key);
+static void __ht_insert(hash_table *ht, const void *key, size_t len,
+                        uint64_t hash, void *value);
+static int __ht_delete(hash_table *ht, const void *key, size_t len,
+                       uint64_t hash);
 static void __ht_delete_table(hash_table *ht);
 
+/**
+ * Determine whether the given entry holds `key`. The cached hashes and then
+ * the lengths are compared first so that mismatched entries are rejected
+ * without touching the key bytes.
+ *
+ * @param r
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @return bool
+ */
+static inline bool ht_entry_matches(const ht_entry *r, const void *key,
+                                    const size_t len, const uint64_t hash) {
+  return r->hash == hash && r->key_len == len &&
+         memcmp(r->key, key, len) == 0;
+}
+
+/**
+ * Find the bucket indexing `key` in the given index. Each group of control
+ * bytes is matched against the key's 7-bit tag, and only entries whose tag
+ * matches are read. Deleted buckets do not end the search, since the key may
+ * have been placed beyond one before it was deleted; only a group containing
+ * an empty bucket or a full cycle of the probe sequence does.
+ *
+ * @param ctrl
+ * @param index
+ * @param entries
+ * @param capacity
+ * @param reducer See `h_capacity`
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @return int The bucket, or -1 if the key is not present
+ */
+static int ht_find_bucket(const uint8_t *ctrl, const uint32_t *index,
+                          const ht_entry *entries, const unsigned int capacity,
+                          const hash_reducer *reducer, const void *key,
+                          const size_t len, const uint64_t hash) {
+  const uint8_t tag = h_ctrl_tag(hash);
+
+  h_group_probe probe;
+  unsigned int pos = h_group_probe_start(&probe, hash, capacity, reducer);
+
+  for (unsigned int i = h_group_probe_limit(capacity); i > 0; i--) {
+    const h_group g = h_group_load(ctrl + pos);
+
+    h_bitmask match = h_group_match(g, tag);
+    while (match) {
+      const unsigned int idx =
+          h_group_bucket(pos, h_bitmask_next(&match), capacity);
+
+      if (ht_entry_matches(&entries[index[idx]], key, len, hash)) {
+        return (int)idx;
+      }
+    }
+
+    if (h_group_match_empty(g)) {
+      break;
+    }
+
+    pos = h_group_probe_next(&probe);
+  }
+
+  return -1;
+}
+
+/**
+ * Find the bucket indexing `key`, consulting the index being migrated away
+ * from if an incremental rehash is in progress.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @param in_old Set to whether the bucket is one of the old index's
+ * @return int The bucket, or -1 if the key is not present
+ */
+static int ht_locate(hash_table *ht, const void *key, const size_t len,
+                     const uint64_t hash, bool *in_old) {
+  *in_old = false;
+  int idx = ht_find_bucket(ht->ctrl, ht->index, ht->entries, ht->capacity,
+                           &ht->reducer, key, len, hash);
+
+  if (idx == -1 && ht->old_ctrl != NULL) {
+    *in_old = true;
+    idx = ht_find_bucket(ht->old_ctrl, ht->old_index, ht->entries,
+                         ht->old_capacity, &ht->old_reducer, key, len, hash);
+  }
+
+  return idx;
+}
+
+/**
+ * Find the first empty or deleted bucket along the probe sequence for `hash`.
+ * The table's load limit guarantees there is one.
+ *
+ * @param ht
+ * @param hash
+ * @return unsigned int
+ */
+static unsigned int ht_find_free_bucket(hash_table *ht, const uint64_t hash) {
+  h_group_probe probe;
+  unsigned int pos =
+      h_group_probe_start(&probe, hash, ht->capacity, &ht->reducer);
+
+  for (;;) {
+    h_bitmask free_mask = h_group_match_empty_or_deleted(
+        h_group_load(ht->ctrl + pos));
+
+    if (free_mask) {
+      return h_group_bucket(pos, h_bitmask_next(&free_mask), ht->capacity);
+    }
+
+    pos = h_group_probe_next(&probe);
+  }
+}
+
+/**
+ * Index the entry at position `pos` of the entries array under a free bucket
+ * of the current index, keeping the table's count of deleted markers up to
+ * date. The index must not already contain the entry's key.
+ *
+ * @param ht
+ * @param pos
+ */
+static void ht_index_entry(hash_table *ht, const uint32_t pos) {
+  const uint64_t hash = ht->entries[pos].hash;
+  const unsigned int idx = ht_find_free_bucket(ht, hash);
+
+  if (ht->ctrl[idx] == H_CTRL_DELETED) {
+    ht->deleted--;
+  }
+
+  h_ctrl_set(ht->ctrl, ht->capacity, idx, h_ctrl_tag(hash));
+  ht->index[idx] = pos;
+}
+
+/**
+ * Size in bytes of the index allocation for a capacity: the bucket positions,
+ * then the control bytes.
+ *
+ * @param capacity
+ * @return size_t
+ */
+static size_t ht_index_size(const unsigned int capacity) {
+  return (size_t)capacity * sizeof(uint32_t) + capacity + H_GROUP_WIDTH - 1;
+}
+
+/**
+ * Allocate an empty index for the given base capacity, replacing the table's
+ * current one. The bucket positions and control bytes share a single
+ * allocation, owned by `index`; the control bytes follow the positions so both
+ * stay aligned.
+ *
+ * @param ht
+ * @param base_capacity
+ */
+static void ht_init_buckets(hash_table *ht, const int base_capacity) {
+  ht->base_capacity = base_capacity;
+  ht->capacity = h_capacity(ht->base_capacity, ht->opts.pow2_capacity,
+                            &ht->reducer);
+
+  const size_t index_size = (size_t)ht->capacity * sizeof(uint32_t);
+
+  ht->index = h_alloc(&ht->opts.allocator, ht_index_size(ht->capacity));
+  ht->ctrl = (uint8_t *)ht->index + index_size;
+  memset(ht->ctrl, H_CTRL_EMPTY, (size_t)ht->capacity + H_GROUP_WIDTH - 1);
+  ht->deleted = 0;
+}
+
+/**
+ * Size the entries array for the current capacity: room for as many entries
+ * as the load limit allows before the next resize, or for every position
+ * already in use if that is more.
+ *
+ * @param ht
+ */
+static void ht_fit_entries(hash_table *ht) {
+  unsigned int entries_cap = ht->capacity * 70 / 100 + 1;
+  if (entries_cap < ht->entries_len) {
+    entries_cap = ht->entries_len;
+  }
+
+  ht->entries = h_realloc(&ht->opts.allocator, ht->entries,
+                          (size_t)ht->entries_cap * sizeof(ht_entry),
+                          (size_t)entries_cap * sizeof(ht_entry));
+  ht->entries_cap = entries_cap;
+}
+
+/**
+ * Close the holes deleted entries left in the entries array, preserving
+ * insertion order. Positions change, so the index must be rebuilt afterwards.
+ *
+ * @param ht
+ */
+static void ht_compact_entries(hash_table *ht) {
+  unsigned int len = 0;
+
+  for (unsigned int pos = 0; pos < ht->entries_len; pos++) {
+    if (ht->entries[pos].key != NULL) {
+      ht->entries[len++] = ht->entries[pos];
+    }
+  }
+
+  ht->entries_len = len;
+}
+
+/**
+ * Index every entry afresh. The index must be empty.
+ *
+ * @param ht
+ */
+static void ht_index_all(hash_table *ht) {
+  for (uint32_t pos = 0; pos < ht->entries_len; pos++) {
+    ht_index_entry(ht, pos);
+  }
+}
+
 /**
  * Resize the hash table. This implementation has a set capacity;
  * hash collisions rise beyond the capacity and `ht_insert` will fail.
  * To mitigate this, we resize up if the load (measured as the ratio of
  * entries count to capacity) is less than .1, or down if the load exceeds
- * .7. To resize, we create a new table approx. 1/2x or 2x times the current
- * table size, then insert into it all non-deleted entries.
+ * .7. To resize, we allocate an index approx. 1/2x or 2x times the current
+ * index size, then index into it all non-deleted entries. Only the index is
+ * rebuilt: entries stay in the entries array and each is indexed by its cached
+ * hash, so keys are never copied, re-hashed or compared.
+ *
+ * If the table has a `rehash_step`, only that many buckets of the old index
+ * are moved now and the rest are moved by subsequent inserts and deletes (see
+ * `ht_rehash`). Otherwise the entries array is compacted and indexed in one
+ * go.
  *
  * @param ht
  * @param base_capacity
@@ -30,42 +260,35 @@ static void ht_resize(hash_table *ht, int base_capacity) {
     base_capacity = HT_DEFAULT_CAPACITY;
   }
 
-  hash_table *new_ht = ht_init(base_capacity, ht->free_value);
+  // Only one migration may be in flight at a time.
+  ht_rehash(ht, HT_REHASH_ALL);
+  ht->resizes++;
 
-  for (unsigned int i = 0; i < ht->capacity; i++) {
-    ht_entry *r = ht->entries[i];
-    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
-      __ht_insert(new_ht, r->key, r->value);
-    }
+  if (!ht->opts.rehash_step) {
+    h_free(&ht->opts.allocator, ht->index, ht_index_size(ht->capacity));
+    ht_init_buckets(ht, base_capacity);
+    ht_compact_entries(ht);
+    ht_fit_entries(ht);
+    ht_index_all(ht);
+    return;
   }
 
-  ht->base_capacity = new_ht->base_capacity;
-  ht->capacity = new_ht->capacity;
-  ht->count = new_ht->count;
-
-  // Cannot free values - we may still be using them.
-  ht_entry **tmp_entries = ht->entries;
-  ht->entries = new_ht->entries;
-  free(tmp_entries);
-
-  // TODO: Figure out why list_free doesnt work but this does
-  node_t *head = ht->occupied_buckets;
-  node_t *tmp;
-
-  while (!list_is_sentinel_node(head)) {
-    tmp = head;
-    head = head->next;
-    free(tmp);
-  }
+  // The old index refers to entries by position, so leave them in place.
+  ht->old_ctrl = ht->ctrl;
+  ht->old_index = ht->index;
+  ht->old_capacity = ht->capacity;
+  ht->old_reducer = ht->reducer;
+  ht->rehash_idx = 0;
 
-  ht->occupied_buckets = new_ht->occupied_buckets;
+  ht_init_buckets(ht, base_capacity);
+  ht_fit_entries(ht);
 
-  free(new_ht);
+  ht_rehash(ht, ht->opts.rehash_step);
 }
 
 /**
- * Resize the table to a larger size, the first prime subsequent
- * to approx. 2x the base capacity.
+ * Resize the table to a larger size, the first growth prime (or power of
+ * two) at or above approx. 2x the base capacity.
  *
  * @param ht
  */
@@ -75,8 +298,8 @@ static void ht_resize_up(hash_table *ht) {
 }
 
 /**
- * Resize the table to a smaller size, the first prime subsequent
- * to approx. 1/2x the base capacity.
+ * Resize the table to a smaller size, the first growth prime (or power of
+ * two) at or above approx. 1/2x the base capacity.
  *
  * @param ht
  */
@@ -86,150 +309,435 @@ static void ht_resize_down(hash_table *ht) {
 }
 
 /**
- * Initialize a new hash table entry with the given k, v pair
+ * Return which group of the probe sequence for `hash` bucket `idx` falls in,
+ * counting from 0.
  *
- * @param k entry key
+ * @param capacity
+ * @param reducer
+ * @param hash
+ * @param idx
+ * @return unsigned int
+ */
+static unsigned int ht_probe_group(const unsigned int capacity,
+                                   const hash_reducer *reducer,
+                                   const uint64_t hash,
+                                   const unsigned int idx) {
+  h_group_probe probe;
+  const unsigned int start =
+      h_group_probe_start(&probe, hash, capacity, reducer);
+
+  return ((idx + capacity - start) % capacity) / H_GROUP_WIDTH;
+}
+
+/**
+ * Return how many groups a lookup of `hash` probes in the given index before
+ * giving up on it, as `ht_find_bucket` does on a miss: up to and including the
+ * first group with an empty bucket.
+ *
+ * @param ctrl
+ * @param capacity
+ * @param reducer
+ * @param hash
+ * @return unsigned int
+ */
+static unsigned int ht_probe_miss_groups(const uint8_t *ctrl,
+                                         const unsigned int capacity,
+                                         const hash_reducer *reducer,
+                                         const uint64_t hash) {
+  h_group_probe probe;
+  unsigned int pos = h_group_probe_start(&probe, hash, capacity, reducer);
+
+  const unsigned int limit = h_group_probe_limit(capacity);
+  for (unsigned int groups = 1; groups < limit; groups++) {
+    if (h_group_match_empty(h_group_load(ctrl + pos))) {
+      return groups;
+    }
+
+    pos = h_group_probe_next(&probe);
+  }
+
+  return limit;
+}
+
+/**
+ * Rebuild the table in place at its current capacity, dropping every deleted
+ * marker and every hole in the entries array. Deleted markers keep probe
+ * sequences going past buckets that are free, so a table whose keys churn at a
+ * steady count accumulates them without ever growing; this restores the probe
+ * lengths of a freshly built table without allocating. Because the index only
+ * holds positions, it is simply cleared and refilled from the compacted
+ * entries.
+ *
+ * @param ht
+ */
+static void ht_purge(hash_table *ht) {
+  ht_rehash(ht, HT_REHASH_ALL);
+
+  ht_compact_entries(ht);
+  memset(ht->ctrl, H_CTRL_EMPTY, (size_t)ht->capacity + H_GROUP_WIDTH - 1);
+  ht->deleted = 0;
+  ht_index_all(ht);
+
+  ht->purges++;
+}
+
+/**
+ * Claim the next position of the entries array for a new entry. If the array
+ * is full it is compacted when deletes have left enough holes to be worth it,
+ * or else grown.
+ *
+ * @param ht
+ * @return uint32_t
+ */
+static uint32_t ht_append_entry(hash_table *ht) {
+  if (ht->entries_len == ht->entries_cap) {
+    if ((ht->entries_len - ht->count) * 4 >= ht->entries_len) {
+      ht_purge(ht);
+    } else {
+      ht->entries = h_realloc(&ht->opts.allocator, ht->entries,
+                              (size_t)ht->entries_cap * sizeof(ht_entry),
+                              (size_t)ht->entries_cap * 2 * sizeof(ht_entry));
+      ht->entries_cap *= 2;
+    }
+  }
+
+  return ht->entries_len++;
+}
+
+/**
+ * Initialize the hash table entry `r` with the given k, v pair
+ *
+ * @param r entry to initialize
+ * @param k entry key, as stored by `h_key_store`
+ * @param len length of the entry key in bytes
+ * @param hash `h_hash` digest of the entry key
  * @param v entry value
- * @return ht_entry*
  */
-static ht_entry *ht_entry_init(const char *k, void *v) {
-  ht_entry *r = malloc(sizeof(ht_entry));
-  r->key = strdup(k);
+static void ht_entry_init(ht_entry *r, char *k, const size_t len,
+                          const uint64_t hash, void *v) {
+  r->key = k;
+  r->key_len = len;
   r->value = v;
-
-  return r;
+  r->hash = hash;
 }
 
 /**
- * Delete a entry and deallocate its memory
+ * Delete a entry, deallocating the memory it owns. The entry itself lives in
+ * the entries array and is not freed; its NULL key marks the hole it leaves.
  *
  * @param r entry to delete
+ * @param opts the options of the table the entry belongs to, which determine
+ * how its key was stored (see `h_key_store`)
  */
-static void ht_delete_entry(ht_entry *r, free_fn *maybe_free_value) {
-  free(r->key);
+static void ht_delete_entry(ht_entry *r, const hash_opts *opts,
+                            free_fn *maybe_free_value) {
+  h_key_free(r->key, r->key_len, opts);
+  r->key = NULL;
   if (maybe_free_value && r->value) {
     maybe_free_value(r->value);
     r->value = NULL;
   }
-  free(r);
 }
 
-static void __ht_insert(hash_table *ht, const char *key, void *value) {
-  if (ht == NULL) {
-    return;
+/**
+ * Find the entry for `key`, inserting one with a NULL value if there is none.
+ * The key is hashed and probed for once either way. The table is only grown
+ * or purged when an entry is inserted, so a hit performs no allocation.
+ *
+ * @param ht
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @param inserted Set to whether the entry was inserted
+ * @return ht_entry*
+ */
+static ht_entry *ht_upsert(hash_table *ht, const void *key, const size_t len,
+                           const uint64_t hash, bool *inserted) {
+  ht_rehash(ht, ht->opts.rehash_step);
+
+  bool in_old;
+  const int existing_idx = ht_locate(ht, key, len, hash, &in_old);
+  if (existing_idx != -1) {
+    *inserted = false;
+    return &ht->entries[in_old ? ht->old_index[existing_idx]
+                               : ht->index[existing_idx]];
   }
 
   const unsigned int load = ht->count * 100 / ht->capacity;
   if (load > 70) {
     ht_resize_up(ht);
+  } else if ((ht->count + ht->deleted) * 100 / ht->capacity > 70 &&
+             ht->deleted * 100 / ht->capacity >= 15) {
+    // Deleted markers have pushed the effective load past the growth limit
+    // without the live load getting there. Waiting until they make up a
+    // sizeable share of the buckets amortizes each purge over many deletes.
+    ht_purge(ht);
   }
 
-  ht_entry *new_entry = ht_entry_init(key, value);
-
-  unsigned int idx = h_compute_hash(new_entry->key, ht->capacity, 0);
-  ht_entry *current_entry = ht->entries[idx];
-  // If there was a hash collision, we need to perform double hashing and
-  // partial linear probing by incrementing this index and hashing it until we
-  // find a bucket.
-  unsigned int i = 1;
-  while (current_entry != NULL && current_entry != &HT_SENTINEL_ENTRY) {
-    // If the keys match, then we've inserted this key before. Use this bucket.
-    if (strcmp(current_entry->key, key) == 0) {
-      ht_delete_entry(current_entry, NULL);
-      ht->entries[idx] = new_entry;
-      return;
-    }
+  const uint32_t pos = ht_append_entry(ht);
+  ht_entry_init(&ht->entries[pos],
+                h_key_store(key, len, &ht->opts, &ht->arena), len, hash,
+                NULL);
+  ht_index_entry(ht, pos);
+  ht->count++;
 
-    idx = h_compute_hash(new_entry->key, ht->capacity, i);
-    current_entry = ht->entries[idx];
-    i++;
+  *inserted = true;
+  return &ht->entries[pos];
+}
+
+/**
+ * Overwrite the value of an existing entry, passing the old value to
+ * `maybe_free_value` unless it is the same value being stored again.
+ *
+ * @param r
+ * @param value
+ * @param maybe_free_value
+ */
+static void ht_replace_value(ht_entry *r, void *value,
+                             free_fn *maybe_free_value) {
+  if (maybe_free_value && r->value && r->value != value) {
+    maybe_free_value(r->value);
   }
+  r->value = value;
+}
 
-  ht->entries[idx] = new_entry;
-  list_prepend(&ht->occupied_buckets, idx);
-  ht->count++;
+static void __ht_insert(hash_table *ht, const void *key, const size_t len,
+                        const uint64_t hash, void *value) {
+  if (ht == NULL) {
+    return;
+  }
+
+  bool inserted;
+  ht_entry *r = ht_upsert(ht, key, len, hash, &inserted);
+
+  // If the keys match, then we've inserted this key before. Overwrite the
+  // value where it is, so the entry keeps its key and its place in the
+  // iteration order.
+  if (!inserted) {
+    ht_replace_value(r, value, ht->free_value);
+    return;
+  }
+
+  r->value = value;
 }
 
-static int __ht_delete(hash_table *ht, const char *key) {
-  const unsigned int load = ht->count * 100 / ht->capacity;
+/**
+ * Link the hole just left at `pos` into the runs of holes around it, so that
+ * iteration skips the merged run in one step (see `HT_ITER_START`). A hole's
+ * neighbours are either live or the near end of their own run, so only the
+ * two ends of the merged run need updating. A run reaching the end of the
+ * array is dropped from it instead, leaving the last entry always live.
+ *
+ * @param ht
+ * @param pos
+ */
+static void ht_link_hole(hash_table *ht, const unsigned int pos) {
+  ht_entry *entries = ht->entries;
+  unsigned int bottom = pos, top = pos;
 
-  // TODO: const
-  if (load < 30) {
-    ht_resize_down(ht);
+  if (pos > 0 && entries[pos - 1].key == NULL) {
+    bottom = entries[pos - 1].hole_end;
+  }
+  if (pos + 1 < ht->entries_len && entries[pos + 1].key == NULL) {
+    top = entries[pos + 1].hole_end;
   }
 
-  unsigned int i = 0;
-  unsigned int idx = h_compute_hash(key, ht->capacity, i);
+  if (top + 1 == ht->entries_len) {
+    ht->entries_len = bottom;
+    return;
+  }
 
-  ht_entry *current_entry = ht->entries[idx];
-  while (current_entry != NULL && current_entry != &HT_SENTINEL_ENTRY) {
-    if (strcmp(current_entry->key, key) == 0) {
-      ht_delete_entry(current_entry, ht->free_value);
-      ht->entries[idx] = &HT_SENTINEL_ENTRY;
-      list_remove(&ht->occupied_buckets, idx);
-      ht->count--;
+  entries[top].hole_end = bottom;
+  entries[bottom].hole_end = top;
+}
 
-      return 1;
-    }
+static int __ht_delete(hash_table *ht, const void *key, const size_t len,
+                       const uint64_t hash) {
+  ht_rehash(ht, ht->opts.rehash_step);
 
-    idx = h_compute_hash(key, ht->capacity, ++i);
-    current_entry = ht->entries[idx];
+  bool in_old;
+  const int idx = ht_locate(ht, key, len, hash, &in_old);
+  if (idx == -1) {
+    return 0;
   }
 
-  return 0;
+  uint32_t pos;
+  if (in_old) {
+    pos = ht->old_index[idx];
+    h_ctrl_set(ht->old_ctrl, ht->old_capacity, idx, H_CTRL_DELETED);
+  } else {
+    pos = ht->index[idx];
+    h_ctrl_set(ht->ctrl, ht->capacity, idx, H_CTRL_DELETED);
+    ht->deleted++;
+  }
+  ht_delete_entry(&ht->entries[pos], &ht->opts, ht->free_value);
+  ht_link_hole(ht, pos);
+  ht->count--;
+
+  // At the minimum capacity there is nothing to shrink to, and resizing would
+  // only rebuild the table as it is.
+  if (ht->base_capacity > HT_DEFAULT_CAPACITY &&
+      ht->count * 100 / ht->capacity < 30) {
+    ht_resize_down(ht);
+  }
+
+  return 1;
 }
 
 static void __ht_delete_table(hash_table *ht) {
-  for (unsigned int i = 0; i < ht->capacity; i++) {
-    ht_entry *r = ht->entries[i];
-
-    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
-      ht_delete_entry(r, ht->free_value);
-    }
+  // Borrowed and arena keys need no freeing one by one, so unless there are
+  // values to free there is nothing to visit the entries for.
+  if (h_key_owned(&ht->opts) || ht->free_value) {
+    HT_ITER_START(ht)
+    ht_delete_entry(entry, &ht->opts, ht->free_value);
+    HT_ITER_END
   }
 
-  free(ht->entries);
-  free(ht);
+  // The table itself was allocated with the allocator it holds.
+  const hash_allocator allocator = ht->opts.allocator;
+
+  h_arena_free(ht->arena, &allocator);
+  if (ht->old_index != NULL) {
+    h_free(&allocator, ht->old_index, ht_index_size(ht->old_capacity));
+  }
+  h_free(&allocator, ht->index, ht_index_size(ht->capacity));
+  h_free(&allocator, ht->entries, (size_t)ht->entries_cap * sizeof(ht_entry));
+  h_free(&allocator, ht, sizeof(hash_table));
 }
 
 hash_table *ht_init(int base_capacity, free_fn *free_value) {
+  return ht_init_opts(base_capacity, free_value, NULL);
+}
+
+hash_table *ht_init_opts(int base_capacity, free_fn *free_value,
+                         const hash_opts *opts) {
   if (base_capacity < HT_DEFAULT_CAPACITY) {
     base_capacity = HT_DEFAULT_CAPACITY;
   }
 
-  hash_table *ht = malloc(sizeof(hash_table));
-  ht->base_capacity = base_capacity;
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
+
+  hash_table *ht = h_alloc(&opts->allocator, sizeof(hash_table));
+  ht->opts = *opts;
+
+  ht_init_buckets(ht, base_capacity);
+
+  ht->entries = NULL;
+  ht->entries_len = 0;
+  ht->entries_cap = 0;
+  ht_fit_entries(ht);
 
-  ht->capacity = next_prime(ht->base_capacity);
   ht->count = 0;
-  ht->entries = calloc((size_t)ht->capacity, sizeof(ht_entry *));
+  ht->resizes = 0;
+  ht->purges = 0;
   ht->free_value = free_value;
-  ht->occupied_buckets = list_create_sentinel_node();
+
+  ht->old_ctrl = NULL;
+  ht->old_index = NULL;
+  ht->old_capacity = 0;
+  memset(&ht->old_reducer, 0, sizeof(hash_reducer));
+  ht->rehash_idx = 0;
+
+  ht->arena = NULL;
+
   return ht;
 }
 
+int ht_rehash(hash_table *ht, unsigned int buckets) {
+  if (ht->old_ctrl == NULL) {
+    return 0;
+  }
+
+  // Walk the old control bytes a group at a time, visiting only the occupied
+  // buckets within each group.
+  while (buckets > 0 && ht->rehash_idx < ht->old_capacity) {
+    const unsigned int pos = ht->rehash_idx;
+
+    unsigned int span = ht->old_capacity - pos;
+    if (span > H_GROUP_WIDTH) {
+      span = H_GROUP_WIDTH;
+    }
+    if (span > buckets) {
+      span = buckets;
+    }
+
+    h_bitmask full = h_group_match_full(h_group_load(ht->old_ctrl + pos)) &
+                     ((1u << span) - 1);
+    while (full) {
+      const unsigned int idx = pos + h_bitmask_next(&full);
+
+      ht_index_entry(ht, ht->old_index[idx]);
+      // Lookups for keys that have not migrated yet may still probe through
+      // this bucket, so it must not read as empty.
+      h_ctrl_set(ht->old_ctrl, ht->old_capacity, idx, H_CTRL_DELETED);
+    }
+
+    ht->rehash_idx += span;
+    buckets -= span;
+  }
+
+  if (ht->rehash_idx < ht->old_capacity) {
+    return 1;
+  }
+
+  h_free(&ht->opts.allocator, ht->old_index, ht_index_size(ht->old_capacity));
+  ht->old_ctrl = NULL;
+  ht->old_index = NULL;
+  ht->old_capacity = 0;
+
+  return 0;
+}
+
 void ht_insert(hash_table *ht, const char *key, void *value) {
-  __ht_insert(ht, key, value);
+  ht_insert_n(ht, key, strlen(key), value);
 }
 
-ht_entry *ht_search(hash_table *ht, const char *key) {
-  unsigned int idx = h_compute_hash(key, ht->capacity, 0);
+void ht_insert_n(hash_table *ht, const void *key, size_t len, void *value) {
+  __ht_insert(ht, key, len, h_hash(key, len), value);
+}
 
-  ht_entry *current_entry = ht->entries[idx];
+void h_ht_insert(hash_table *ht, const void *key, size_t len, uint64_t hash,
+                 void *value) {
+  __ht_insert(ht, key, len, hash, value);
+}
 
-  unsigned int i = 1;
+void **ht_get_or_insert(hash_table *ht, const char *key, bool *inserted) {
+  return ht_get_or_insert_n(ht, key, strlen(key), inserted);
+}
 
-  while (current_entry != NULL && current_entry != &HT_SENTINEL_ENTRY) {
-    if (strcmp(current_entry->key, key) == 0) {
-      return current_entry;
-    }
+void **ht_get_or_insert_n(hash_table *ht, const void *key, size_t len,
+                          bool *inserted) {
+  bool was_inserted;
+  ht_entry *r = ht_upsert(ht, key, len, h_hash(key, len), &was_inserted);
 
-    idx = h_compute_hash(key, ht->capacity, i);
-    current_entry = ht->entries[idx];
-    i++;
+  if (inserted != NULL) {
+    *inserted = was_inserted;
   }
 
-  return NULL;
+  return &r->value;
+}
+
+ht_entry *ht_search(hash_table *ht, const char *key) {
+  return ht_search_n(ht, key, strlen(key));
+}
+
+ht_entry *ht_search_n(hash_table *ht, const void *key, size_t len) {
+  return h_ht_search(ht, key, len, h_hash(key, len));
+}
+
+ht_entry *h_ht_search(hash_table *ht, const void *key, size_t len,
+                      uint64_t hash) {
+  bool in_old;
+  const int idx = ht_locate(ht, key, len, hash, &in_old);
+
+  if (idx == -1) {
+    return NULL;
+  }
+
+  return &ht->entries[in_old ? ht->old_index[idx] : ht->index[idx]];
 }
 
 void *ht_get(hash_table *ht, const char *key) {
@@ -237,6 +745,65 @@ void *ht_get(hash_table *ht, const char *key) {
   return r ? r->value : NULL;
 }
 
+void *ht_get_n(hash_table *ht, const void *key, size_t len) {
+  ht_entry *r = ht_search_n(ht, key, len);
+  return r ? r->value : NULL;
+}
+
+void ht_get_stats(hash_table *ht, ht_stats *stats) {
+  stats->capacity = ht->capacity;
+  stats->count = ht->count;
+  stats->deleted = ht->deleted;
+  stats->resizes = ht->resizes;
+  stats->purges = ht->purges;
+  stats->max_probe_groups = 0;
+
+  unsigned long total_probe_groups = 0;
+
+  for (unsigned int i = 0; i < ht->capacity; i++) {
+    if (h_ctrl_is_full(ht->ctrl[i])) {
+      const unsigned int groups =
+          ht_probe_group(ht->capacity, &ht->reducer,
+                         ht->entries[ht->index[i]].hash, i) +
+          1;
+
+      total_probe_groups += groups;
+      if (groups > stats->max_probe_groups) {
+        stats->max_probe_groups = groups;
+      }
+    }
+  }
+
+  // Entries still in the old index of an in-progress rehash are found after
+  // their lookup misses in the current index.
+  for (unsigned int i = ht->rehash_idx; i < ht->old_capacity; i++) {
+    if (h_ctrl_is_full(ht->old_ctrl[i])) {
+      const uint64_t hash = ht->entries[ht->old_index[i]].hash;
+      const unsigned int groups =
+          ht_probe_miss_groups(ht->ctrl, ht->capacity, &ht->reducer, hash) +
+          ht_probe_group(ht->old_capacity, &ht->old_reducer, hash, i) + 1;
+
+      total_probe_groups += groups;
+      if (groups > stats->max_probe_groups) {
+        stats->max_probe_groups = groups;
+      }
+    }
+  }
+
+  stats->mean_probe_groups =
+      ht->count ? (double)total_probe_groups / ht->count : 0;
+}
+
 void ht_delete_table(hash_table *ht) { __ht_delete_table(ht); }
 
-int ht_delete(hash_table *ht, const char *key) { return __ht_delete(ht, key); }
+int ht_delete(hash_table *ht, const char *key) {
+  return ht_delete_n(ht, key, strlen(key));
+}
+
+int ht_delete_n(hash_table *ht, const void *key, size_t len) {
+  return __ht_delete(ht, key, len, h_hash(key, len));
+}
+
+int h_ht_delete(hash_table *ht, const void *key, size_t len, uint64_t hash) {
+  return __ht_delete(ht, key, len, hash);
+}
@@ -0,0 +1,19 @@
+#ifndef LIBHASH_HASH_TABLE_H
+#define LIBHASH_HASH_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libhash.h"
+
+/**
+ * Variants of ht_insert_n, ht_search_n and ht_delete_n for callers that have
+ * already hashed the key with `h_hash`, e.g. to pick a table to use.
+ */
+void h_ht_insert(hash_table *ht, const void *key, size_t len, uint64_t hash,
+                 void *value);
+ht_entry *h_ht_search(hash_table *ht, const void *key, size_t len,
+                      uint64_t hash);
+int h_ht_delete(hash_table *ht, const void *key, size_t len, uint64_t hash);
+
+#endif /* LIBHASH_HASH_TABLE_H */
@@ -0,0 +1,599 @@
+// pthread_rwlock_t is only declared by POSIX.1-2001 and later.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+
+/**
+ * The epoch of a thread that is not registered. It holds nothing, so it
+ * never delays a free.
+ */
+#define LF_OFFLINE UINT64_MAX
+
+/**
+ * Writers free what they can once this many frees are pending, or twice as
+ * many as the last attempt had to keep, whichever is more.
+ */
+#define LF_RECLAIM_BATCH 64
+
+/**
+ * An entry. Once published in a bucket it never changes: an update publishes
+ * a new entry in its place, so readers always see a key and value that
+ * belong together.
+ */
+typedef struct {
+  char *key;
+  size_t key_len;
+  uint64_t hash;
+  void *value;
+} lf_node;
+
+/**
+ * The bucket a deleted entry leaves. It is skipped by lookups and never
+ * reused, so the first empty bucket along a key's probe sequence is the only
+ * place it can be inserted, and two writers inserting the same key always
+ * race for the same bucket.
+ */
+static lf_node lf_tombstone;
+#define LF_TOMBSTONE (&lf_tombstone)
+
+/**
+ * A bucket array. Its capacity and reducer are stored with it, so a reader
+ * that loaded the array probes it consistently even if it is replaced
+ * meanwhile.
+ */
+struct lf_buckets {
+  unsigned int capacity;
+  hash_reducer reducer;
+  _Atomic(lf_node *) slots[];
+};
+
+/**
+ * A registered thread. Each is aligned to a cache line of its own, which only
+ * its thread writes to.
+ */
+struct lf_thread {
+  /**
+   * The table epoch as of the thread's last quiescent state, or LF_OFFLINE
+   */
+  _Alignas(H_CACHE_LINE) _Atomic uint64_t epoch;
+
+  lf_thread *next;
+  lf_table *lf;
+
+  /**
+   * The allocation the thread points into
+   */
+  void *alloc;
+};
+
+/**
+ * A deferred free, of an entry or of a bucket array. It may be carried out
+ * once every registered thread's epoch is past `epoch`.
+ */
+struct lf_retired {
+  struct lf_retired *next;
+  uint64_t epoch;
+  lf_node *node;
+  struct lf_buckets *buckets;
+};
+
+/**
+ * The state threads share through atomics, kept out of lf_table so that
+ * libhash.h declares no atomics of its own.
+ */
+struct lf_state {
+  _Atomic(struct lf_buckets *) buckets;
+
+  /**
+   * Number of entries in the table
+   */
+  _Atomic unsigned int count;
+
+  /**
+   * Number of non-empty buckets: entries and tombstones. Tombstones are only
+   * cleared by a resize.
+   */
+  _Atomic unsigned int used;
+
+  /**
+   * Advanced by every deferred free. Reading threads announce the value they
+   * last saw in `lf_quiescent`.
+   */
+  _Atomic uint64_t epoch;
+
+  /**
+   * Every thread ever registered. Unregistered threads are marked offline,
+   * to be reused by the next registration, and freed with the table.
+   */
+  _Atomic(lf_thread *) threads;
+
+  /**
+   * Deferred frees, newest first, and their number
+   */
+  _Atomic(struct lf_retired *) retired;
+  _Atomic unsigned int retired_count;
+
+  /**
+   * The `retired_count` at which writers next try to free. See
+   * LF_RECLAIM_BATCH.
+   */
+  _Atomic unsigned int reclaim_at;
+
+  /**
+   * Writers hold this shared while they swap buckets, and exclusively to
+   * resize or to free retired memory, neither of which may run under another
+   * writer. Readers never take it.
+   */
+  pthread_rwlock_t writers;
+};
+
+static size_t lf_buckets_size(const unsigned int capacity) {
+  return sizeof(struct lf_buckets) + capacity * sizeof(_Atomic(lf_node *));
+}
+
+static size_t lf_thread_size(void) {
+  return sizeof(lf_thread) + H_CACHE_LINE - 1;
+}
+
+static bool lf_node_matches(const lf_node *n, const void *key,
+                            const size_t len, const uint64_t hash) {
+  return n != LF_TOMBSTONE && n->hash == hash && n->key_len == len &&
+         memcmp(n->key, key, len) == 0;
+}
+
+/**
+ * Allocate an empty bucket array for a base capacity.
+ *
+ * @param lf
+ * @param base_capacity
+ * @return struct lf_buckets*
+ */
+static struct lf_buckets *lf_alloc_buckets(const lf_table *lf,
+                                           const unsigned int base_capacity) {
+  hash_reducer reducer;
+  const unsigned int capacity =
+      h_capacity((int)base_capacity, lf->opts.pow2_capacity, &reducer);
+
+  struct lf_buckets *b =
+      h_alloc(&lf->opts.allocator, lf_buckets_size(capacity));
+  b->capacity = capacity;
+  b->reducer = reducer;
+  for (unsigned int i = 0; i < capacity; i++) {
+    atomic_init(&b->slots[i], NULL);
+  }
+
+  return b;
+}
+
+/**
+ * Find the entry for `key` in a bucket array, probing linearly from its home
+ * bucket. Makes no writes.
+ *
+ * @param b
+ * @param key
+ * @param len
+ * @param hash `h_hash` digest of `key`
+ * @return lf_node* The entry, or NULL if the key is not present
+ */
+static lf_node *lf_find(struct lf_buckets *b, const void *key,
+                        const size_t len, const uint64_t hash) {
+  unsigned int idx = h_reduce(hash, b->capacity, &b->reducer);
+
+  for (unsigned int i = b->capacity; i > 0; i--) {
+    lf_node *n = atomic_load_explicit(&b->slots[idx], memory_order_acquire);
+
+    if (n == NULL) {
+      return NULL;
+    }
+    if (lf_node_matches(n, key, len, hash)) {
+      return n;
+    }
+
+    if (++idx == b->capacity) {
+      idx = 0;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Free an entry along with its key, and its value if `free_value` is set.
+ *
+ * @param lf
+ * @param n
+ * @param free_value
+ */
+static void lf_free_node(const lf_table *lf, lf_node *n,
+                         const bool free_value) {
+  h_key_free(n->key, n->key_len, &lf->opts);
+  if (free_value && lf->free_value && n->value) {
+    lf->free_value(n->value);
+  }
+  h_free(&lf->opts.allocator, n, sizeof(lf_node));
+}
+
+static void lf_free_retired(const lf_table *lf, struct lf_retired *r) {
+  if (r->node != NULL) {
+    lf_free_node(lf, r->node, true);
+  }
+  if (r->buckets != NULL) {
+    h_free(&lf->opts.allocator, r->buckets,
+           lf_buckets_size(r->buckets->capacity));
+  }
+  h_free(&lf->opts.allocator, r, sizeof(struct lf_retired));
+}
+
+/**
+ * Defer freeing an entry or bucket array that has been unlinked, until no
+ * reading thread can still hold it. The epoch is advanced after the unlink,
+ * so any thread announcing a later epoch has seen it.
+ *
+ * @param lf
+ * @param node An entry to free, with its key and value, or NULL
+ * @param buckets A bucket array to free, or NULL
+ */
+static void lf_retire(lf_table *lf, lf_node *node,
+                      struct lf_buckets *buckets) {
+  struct lf_retired *r =
+      h_alloc(&lf->opts.allocator, sizeof(struct lf_retired));
+  r->node = node;
+  r->buckets = buckets;
+  r->epoch = atomic_fetch_add(&lf->state->epoch, 1);
+
+  r->next = atomic_load(&lf->state->retired);
+  while (!atomic_compare_exchange_weak(&lf->state->retired, &r->next, r)) {
+  }
+  atomic_fetch_add(&lf->state->retired_count, 1);
+}
+
+/**
+ * Carry out every deferred free whose grace period has passed: every
+ * registered thread has announced a later epoch. Writers must be excluded.
+ *
+ * @param lf
+ */
+static void lf_reclaim(lf_table *lf) {
+  uint64_t min = LF_OFFLINE;
+  for (lf_thread *t = atomic_load(&lf->state->threads); t != NULL;
+       t = t->next) {
+    const uint64_t epoch =
+        atomic_load_explicit(&t->epoch, memory_order_acquire);
+    if (epoch < min) {
+      min = epoch;
+    }
+  }
+
+  struct lf_retired *r = atomic_exchange(&lf->state->retired, NULL);
+  struct lf_retired *kept = NULL;
+  unsigned int kept_count = 0;
+
+  while (r != NULL) {
+    struct lf_retired *next = r->next;
+
+    if (r->epoch < min) {
+      lf_free_retired(lf, r);
+    } else {
+      r->next = kept;
+      kept = r;
+      kept_count++;
+    }
+
+    r = next;
+  }
+
+  atomic_store(&lf->state->retired, kept);
+  atomic_store(&lf->state->retired_count, kept_count);
+
+  // While a reader lags, what it holds cannot be freed, and trying again at
+  // a fixed count would have every write walk the whole list. Waiting for it
+  // to double keeps the cost of these walks constant per write.
+  atomic_store(&lf->state->reclaim_at, kept_count * 2 > LF_RECLAIM_BATCH
+                                           ? kept_count * 2
+                                           : LF_RECLAIM_BATCH);
+}
+
+/**
+ * Free what memory can be freed, if enough is pending to be worth excluding
+ * the other writers. The caller must not hold the writers' lock.
+ *
+ * @param lf
+ */
+static void lf_maybe_reclaim(lf_table *lf) {
+  struct lf_state *st = lf->state;
+  if (atomic_load(&st->retired_count) < atomic_load(&st->reclaim_at)) {
+    return;
+  }
+
+  pthread_rwlock_wrlock(&st->writers);
+  // Another writer may have freed what it could while this one waited.
+  if (atomic_load(&st->retired_count) >= atomic_load(&st->reclaim_at)) {
+    lf_reclaim(lf);
+  }
+  pthread_rwlock_unlock(&st->writers);
+}
+
+/**
+ * Replace a full bucket array, dropping its tombstones: at the same capacity
+ * if most of its buckets are tombstones, else at twice the capacity. Only
+ * the entry pointers are copied. Readers may still be probing the old array,
+ * so it is retired rather than freed. The caller must not hold the writers'
+ * lock.
+ *
+ * @param lf
+ * @param seen The bucket array the caller found full. If another writer has
+ * replaced it since, there is nothing left to do.
+ */
+static void lf_resize(lf_table *lf, struct lf_buckets *seen) {
+  pthread_rwlock_wrlock(&lf->state->writers);
+
+  if (atomic_load(&lf->state->buckets) == seen) {
+    const unsigned int count = atomic_load(&lf->state->count);
+    if (count * 100 / seen->capacity > 35) {
+      lf->base_capacity *= 2;
+    }
+
+    struct lf_buckets *b = lf_alloc_buckets(lf, lf->base_capacity);
+    for (unsigned int i = 0; i < seen->capacity; i++) {
+      lf_node *n = atomic_load_explicit(&seen->slots[i], memory_order_relaxed);
+      if (n == NULL || n == LF_TOMBSTONE) {
+        continue;
+      }
+
+      unsigned int idx = h_reduce(n->hash, b->capacity, &b->reducer);
+      while (atomic_load_explicit(&b->slots[idx], memory_order_relaxed)) {
+        if (++idx == b->capacity) {
+          idx = 0;
+        }
+      }
+      atomic_store_explicit(&b->slots[idx], n, memory_order_relaxed);
+    }
+
+    atomic_store(&lf->state->used, count);
+    atomic_store_explicit(&lf->state->buckets, b, memory_order_release);
+    lf_retire(lf, NULL, seen);
+    lf->resizes++;
+  }
+
+  lf_reclaim(lf);
+  pthread_rwlock_unlock(&lf->state->writers);
+}
+
+lf_table *lf_init(int base_capacity, free_fn *free_value) {
+  return lf_init_opts(base_capacity, free_value, NULL);
+}
+
+lf_table *lf_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts) {
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
+
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  lf_table *lf = h_alloc(&opts->allocator, sizeof(lf_table));
+  lf->opts = *opts;
+  lf->opts.arena_keys = false;
+  lf->base_capacity = (unsigned int)base_capacity;
+  lf->free_value = free_value;
+  lf->resizes = 0;
+
+  struct lf_state *st = h_alloc(&lf->opts.allocator, sizeof(struct lf_state));
+  atomic_init(&st->buckets, lf_alloc_buckets(lf, lf->base_capacity));
+  atomic_init(&st->count, 0);
+  atomic_init(&st->used, 0);
+  atomic_init(&st->epoch, 0);
+  atomic_init(&st->threads, NULL);
+  atomic_init(&st->retired, NULL);
+  atomic_init(&st->retired_count, 0);
+  atomic_init(&st->reclaim_at, LF_RECLAIM_BATCH);
+  pthread_rwlock_init(&st->writers, NULL);
+  lf->state = st;
+
+  return lf;
+}
+
+void lf_insert(lf_table *lf, const char *key, void *value) {
+  lf_insert_n(lf, key, strlen(key), value);
+}
+
+void lf_insert_n(lf_table *lf, const void *key, size_t len, void *value) {
+  if (lf == NULL) {
+    return;
+  }
+
+  const uint64_t hash = h_hash(key, len);
+
+  // Every published entry owns its key, including one that replaces another.
+  lf_node *fresh = h_alloc(&lf->opts.allocator, sizeof(lf_node));
+  fresh->key = h_key_store(key, len, &lf->opts, NULL);
+  fresh->key_len = len;
+  fresh->hash = hash;
+  fresh->value = value;
+
+  pthread_rwlock_rdlock(&lf->state->writers);
+
+  for (;;) {
+    struct lf_buckets *b = atomic_load(&lf->state->buckets);
+    unsigned int idx = h_reduce(hash, b->capacity, &b->reducer);
+    unsigned int probes = b->capacity;
+
+    while (probes > 0) {
+      lf_node *n = atomic_load(&b->slots[idx]);
+
+      if (n == NULL) {
+        // Leave room for the inserts other writers may be making.
+        if (atomic_load(&lf->state->used) * 100 / b->capacity >= 70) {
+          break;
+        }
+
+        if (atomic_compare_exchange_strong(&b->slots[idx], &n, fresh)) {
+          atomic_fetch_add(&lf->state->used, 1);
+          atomic_fetch_add(&lf->state->count, 1);
+          goto done;
+        }
+        // Another writer claimed the bucket; `n` is now its entry.
+      }
+
+      if (lf_node_matches(n, key, len, hash)) {
+        if (n->value == value) {
+          lf_free_node(lf, fresh, false);
+          goto done;
+        }
+
+        if (atomic_compare_exchange_strong(&b->slots[idx], &n, fresh)) {
+          lf_retire(lf, n, NULL);
+          goto done;
+        }
+        // The entry was replaced or deleted meanwhile; look again.
+        continue;
+      }
+
+      if (++idx == b->capacity) {
+        idx = 0;
+      }
+      probes--;
+    }
+
+    pthread_rwlock_unlock(&lf->state->writers);
+    lf_resize(lf, b);
+    pthread_rwlock_rdlock(&lf->state->writers);
+  }
+
+done:
+  pthread_rwlock_unlock(&lf->state->writers);
+  lf_maybe_reclaim(lf);
+}
+
+void *lf_get(lf_table *lf, const char *key) {
+  return lf_get_n(lf, key, strlen(key));
+}
+
+void *lf_get_n(lf_table *lf, const void *key, size_t len) {
+  struct lf_buckets *b =
+      atomic_load_explicit(&lf->state->buckets, memory_order_acquire);
+  const lf_node *n = lf_find(b, key, len, h_hash(key, len));
+
+  return n ? n->value : NULL;
+}
+
+int lf_delete(lf_table *lf, const char *key) {
+  return lf_delete_n(lf, key, strlen(key));
+}
+
+int lf_delete_n(lf_table *lf, const void *key, size_t len) {
+  const uint64_t hash = h_hash(key, len);
+  int deleted = 0;
+
+  pthread_rwlock_rdlock(&lf->state->writers);
+
+  struct lf_buckets *b = atomic_load(&lf->state->buckets);
+  unsigned int idx = h_reduce(hash, b->capacity, &b->reducer);
+
+  for (unsigned int probes = b->capacity; probes > 0;) {
+    lf_node *n = atomic_load(&b->slots[idx]);
+    if (n == NULL) {
+      break;
+    }
+
+    if (lf_node_matches(n, key, len, hash)) {
+      if (atomic_compare_exchange_strong(&b->slots[idx], &n, LF_TOMBSTONE)) {
+        atomic_fetch_sub(&lf->state->count, 1);
+        lf_retire(lf, n, NULL);
+        deleted = 1;
+        break;
+      }
+      // The entry was replaced or deleted meanwhile; look again.
+      continue;
+    }
+
+    if (++idx == b->capacity) {
+      idx = 0;
+    }
+    probes--;
+  }
+
+  pthread_rwlock_unlock(&lf->state->writers);
+  lf_maybe_reclaim(lf);
+
+  return deleted;
+}
+
+unsigned int lf_count(lf_table *lf) { return atomic_load(&lf->state->count); }
+
+lf_thread *lf_thread_register(lf_table *lf) {
+  const uint64_t epoch = atomic_load(&lf->state->epoch);
+
+  for (lf_thread *t = atomic_load(&lf->state->threads); t != NULL;
+       t = t->next) {
+    uint64_t offline = LF_OFFLINE;
+    if (atomic_compare_exchange_strong(&t->epoch, &offline, epoch)) {
+      return t;
+    }
+  }
+
+  void *alloc = h_alloc(&lf->opts.allocator, lf_thread_size());
+  lf_thread *t = h_cache_align(alloc);
+  atomic_init(&t->epoch, epoch);
+  t->lf = lf;
+  t->alloc = alloc;
+
+  t->next = atomic_load(&lf->state->threads);
+  while (!atomic_compare_exchange_weak(&lf->state->threads, &t->next, t)) {
+  }
+
+  return t;
+}
+
+void lf_quiescent(lf_thread *thread) {
+  atomic_store_explicit(
+      &thread->epoch,
+      atomic_load_explicit(&thread->lf->state->epoch, memory_order_acquire),
+      memory_order_release);
+}
+
+void lf_thread_unregister(lf_thread *thread) {
+  atomic_store_explicit(&thread->epoch, LF_OFFLINE, memory_order_release);
+}
+
+void lf_delete_table(lf_table *lf) {
+  const hash_allocator allocator = lf->opts.allocator;
+
+  struct lf_buckets *b = atomic_load(&lf->state->buckets);
+  for (unsigned int i = 0; i < b->capacity; i++) {
+    lf_node *n = atomic_load(&b->slots[i]);
+    if (n != NULL && n != LF_TOMBSTONE) {
+      lf_free_node(lf, n, true);
+    }
+  }
+  h_free(&allocator, b, lf_buckets_size(b->capacity));
+
+  struct lf_retired *r = atomic_load(&lf->state->retired);
+  while (r != NULL) {
+    struct lf_retired *next = r->next;
+    lf_free_retired(lf, r);
+    r = next;
+  }
+
+  lf_thread *t = atomic_load(&lf->state->threads);
+  while (t != NULL) {
+    lf_thread *next = t->next;
+    h_free(&allocator, t->alloc, lf_thread_size());
+    t = next;
+  }
+
+  pthread_rwlock_destroy(&lf->state->writers);
+  h_free(&allocator, lf->state, sizeof(struct lf_state));
+  h_free(&allocator, lf, sizeof(lf_table));
+}
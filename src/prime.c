@@ -40,3 +40,51 @@ int next_prime(int x) {
 
   return x;
 }
+
+#define PRIME_RUNG(p) {(p), UINT64_MAX / (p) + 1}
+
+/**
+ * Growth primes, roughly doubling. Each is the first prime at or above
+ * HT_DEFAULT_CAPACITY (53) times a power of two, so a table that starts at the
+ * default capacity and doubles lands exactly on a rung each time. The final
+ * rung is the largest 32-bit prime.
+ */
+static const prime_rung prime_ladder[] = {
+    PRIME_RUNG(2u),          PRIME_RUNG(5u),          PRIME_RUNG(7u),
+    PRIME_RUNG(17u),         PRIME_RUNG(29u),         PRIME_RUNG(53u),
+    PRIME_RUNG(107u),        PRIME_RUNG(223u),        PRIME_RUNG(431u),
+    PRIME_RUNG(853u),        PRIME_RUNG(1697u),       PRIME_RUNG(3407u),
+    PRIME_RUNG(6791u),       PRIME_RUNG(13577u),      PRIME_RUNG(27143u),
+    PRIME_RUNG(54277u),      PRIME_RUNG(108553u),     PRIME_RUNG(217111u),
+    PRIME_RUNG(434179u),     PRIME_RUNG(868369u),     PRIME_RUNG(1736711u),
+    PRIME_RUNG(3473419u),    PRIME_RUNG(6946817u),    PRIME_RUNG(13893637u),
+    PRIME_RUNG(27787267u),   PRIME_RUNG(55574567u),   PRIME_RUNG(111149057u),
+    PRIME_RUNG(222298127u),  PRIME_RUNG(444596227u),  PRIME_RUNG(889192471u),
+    PRIME_RUNG(1778384921u), PRIME_RUNG(4294967291u),
+};
+
+/**
+ * Return the smallest rung of the capacity ladder that is at least `x`, or the
+ * largest rung if `x` exceeds them all. Unlike `next_prime`, this performs no
+ * trial division, and the rung carries the reciprocal that lets probing reduce
+ * hashes modulo the prime without a divide.
+ *
+ * @param x
+ * @return const prime_rung*
+ */
+const prime_rung *prime_ladder_ceil(const unsigned int x) {
+  const unsigned int n = sizeof(prime_ladder) / sizeof(prime_ladder[0]);
+
+  unsigned int lo = 0, hi = n - 1;
+  while (lo < hi) {
+    const unsigned int mid = (lo + hi) / 2;
+
+    if (prime_ladder[mid].prime < x) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return &prime_ladder[lo];
+}
@@ -1,7 +1,19 @@
 #ifndef LIBHASH_PRIME_H
 #define LIBHASH_PRIME_H
 
+#include <stdint.h>
+
+/**
+ * A rung of the capacity ladder (see `prime_ladder_ceil`): a prime and its
+ * precomputed fastmod reciprocal, ceil(2^64 / prime).
+ */
+typedef struct {
+  unsigned int prime;
+  uint64_t magic;
+} prime_rung;
+
 int is_prime(const int x);
 int next_prime(int x);
+const prime_rung *prime_ladder_ceil(const unsigned int x);
 
 #endif /* LIBHASH_PRIME_H */
@@ -0,0 +1,283 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+
+/**
+ * Determine whether the given entry holds `key`. See `ht_entry_matches`.
+ *
+ * @param r
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @return bool
+ */
+static inline bool rh_entry_matches(const ht_entry *r, const char *key,
+                                    const size_t len, const uint64_t hash) {
+  return r->hash == hash && r->key_len == len &&
+         memcmp(r->key, key, len) == 0;
+}
+
+static inline unsigned int rh_next(const rh_table *rh, const unsigned int idx) {
+  return idx + 1 == rh->capacity ? 0 : idx + 1;
+}
+
+/**
+ * Find the bucket holding `key`. Entries are kept ordered by distance from
+ * their home bucket, so the search ends as soon as it reaches a bucket whose
+ * entry is closer to home than the key would be at that point - the key
+ * would have displaced it on insert.
+ *
+ * @param rh
+ * @param key
+ * @param len Length of `key` in bytes
+ * @param hash `h_hash` digest of `key`
+ * @return int The bucket index, or -1 if the key is not present
+ */
+static int rh_find_bucket(const rh_table *rh, const char *key,
+                          const size_t len, const uint64_t hash) {
+  unsigned int idx = h_reduce(hash, rh->capacity, &rh->reducer);
+
+  for (uint32_t dist = 1; dist <= rh->dist[idx]; dist++) {
+    if (rh_entry_matches(&rh->entries[idx], key, len, hash)) {
+      return (int)idx;
+    }
+
+    idx = rh_next(rh, idx);
+  }
+
+  return -1;
+}
+
+/**
+ * Place an entry whose key is not yet in the table. Walking from the entry's
+ * home bucket, whenever the entry being placed is further from home than the
+ * resident, the two swap and we carry on placing the resident ("robbing the
+ * rich"). The table's load limit guarantees there is an empty bucket.
+ *
+ * @param rh
+ * @param r
+ */
+static void rh_place_entry(rh_table *rh, ht_entry r) {
+  unsigned int idx = h_reduce(r.hash, rh->capacity, &rh->reducer);
+  uint32_t dist = 1;
+
+  while (rh->dist[idx] != 0) {
+    if (rh->dist[idx] < dist) {
+      const ht_entry resident = rh->entries[idx];
+      const uint32_t resident_dist = rh->dist[idx];
+
+      rh->entries[idx] = r;
+      rh->dist[idx] = dist;
+
+      r = resident;
+      dist = resident_dist;
+    }
+
+    idx = rh_next(rh, idx);
+    dist++;
+  }
+
+  rh->entries[idx] = r;
+  rh->dist[idx] = dist;
+}
+
+/**
+ * Size in bytes of the buckets allocation for a capacity.
+ *
+ * @param capacity
+ * @return size_t
+ */
+static size_t rh_buckets_size(const unsigned int capacity) {
+  return (size_t)capacity * (sizeof(ht_entry) + sizeof(uint32_t));
+}
+
+/**
+ * Allocate empty buckets for the given base capacity, replacing the table's
+ * current ones. As with `hash_table`, the entries and distances share a single
+ * allocation owned by `entries`.
+ *
+ * @param rh
+ * @param base_capacity
+ */
+static void rh_init_buckets(rh_table *rh, const int base_capacity) {
+  rh->base_capacity = base_capacity;
+  rh->capacity = h_capacity(rh->base_capacity, rh->opts.pow2_capacity,
+                            &rh->reducer);
+
+  const size_t entries_size = (size_t)rh->capacity * sizeof(ht_entry);
+
+  rh->entries = h_alloc(&rh->opts.allocator, rh_buckets_size(rh->capacity));
+  rh->dist = (uint32_t *)((char *)rh->entries + entries_size);
+  memset(rh->dist, 0, (size_t)rh->capacity * sizeof(uint32_t));
+}
+
+/**
+ * Resize the table, re-placing every entry by its cached hash. See
+ * `ht_resize`.
+ *
+ * @param rh
+ * @param base_capacity
+ */
+static void rh_resize(rh_table *rh, int base_capacity) {
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  ht_entry *old_entries = rh->entries;
+  const uint32_t *old_dist = rh->dist;
+  const unsigned int old_capacity = rh->capacity;
+
+  rh_init_buckets(rh, base_capacity);
+
+  for (unsigned int i = 0; i < old_capacity; i++) {
+    if (old_dist[i] != 0) {
+      rh_place_entry(rh, old_entries[i]);
+    }
+  }
+
+  h_free(&rh->opts.allocator, old_entries, rh_buckets_size(old_capacity));
+}
+
+/**
+ * Delete an entry, deallocating the memory it owns. See `ht_delete_entry`.
+ *
+ * @param r entry to delete
+ * @param opts the options of the table the entry belongs to
+ */
+static void rh_delete_entry(ht_entry *r, const hash_opts *opts,
+                            free_fn *maybe_free_value) {
+  h_key_free(r->key, r->key_len, opts);
+  r->key = NULL;
+  if (maybe_free_value && r->value) {
+    maybe_free_value(r->value);
+    r->value = NULL;
+  }
+}
+
+rh_table *rh_init(int base_capacity, free_fn *free_value) {
+  return rh_init_opts(base_capacity, free_value, NULL);
+}
+
+rh_table *rh_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts) {
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
+
+  rh_table *rh = h_alloc(&opts->allocator, sizeof(rh_table));
+  rh->opts = *opts;
+
+  rh_init_buckets(rh, base_capacity);
+
+  rh->count = 0;
+  rh->free_value = free_value;
+  rh->arena = NULL;
+
+  return rh;
+}
+
+void rh_insert(rh_table *rh, const char *key, void *value) {
+  if (rh == NULL) {
+    return;
+  }
+
+  const size_t len = strlen(key);
+  const uint64_t hash = h_hash(key, len);
+
+  // Updating an existing key never reallocates.
+  const int existing_idx = rh_find_bucket(rh, key, len, hash);
+  if (existing_idx != -1) {
+    ht_entry *r = &rh->entries[existing_idx];
+    if (rh->free_value && r->value && r->value != value) {
+      rh->free_value(r->value);
+    }
+    r->value = value;
+    return;
+  }
+
+  // Robin Hood probing keeps probe lengths short at much higher loads than
+  // the hash_table's 70%.
+  const unsigned int load = rh->count * 100 / rh->capacity;
+  if (load > 85) {
+    rh_resize(rh, rh->base_capacity * 2);
+  }
+
+  ht_entry r = {
+      .key = h_key_store(key, len, &rh->opts, &rh->arena),
+      .key_len = len,
+      .value = value,
+      .hash = hash,
+  };
+  rh_place_entry(rh, r);
+  rh->count++;
+}
+
+ht_entry *rh_search(rh_table *rh, const char *key) {
+  const size_t len = strlen(key);
+  const int idx = rh_find_bucket(rh, key, len, h_hash(key, len));
+
+  return idx == -1 ? NULL : &rh->entries[idx];
+}
+
+void *rh_get(rh_table *rh, const char *key) {
+  ht_entry *r = rh_search(rh, key);
+  return r ? r->value : NULL;
+}
+
+int rh_delete(rh_table *rh, const char *key) {
+  const size_t len = strlen(key);
+  const int found = rh_find_bucket(rh, key, len, h_hash(key, len));
+  if (found == -1) {
+    return 0;
+  }
+
+  unsigned int idx = (unsigned int)found;
+  rh_delete_entry(&rh->entries[idx], &rh->opts, rh->free_value);
+
+  // Backward-shift deletion: pull each following entry that is not in its
+  // home bucket back by one, until we reach an empty bucket or an entry that
+  // is. This leaves no tombstone, and every shifted entry moves closer to
+  // home.
+  unsigned int next = rh_next(rh, idx);
+  while (rh->dist[next] > 1) {
+    rh->entries[idx] = rh->entries[next];
+    rh->dist[idx] = rh->dist[next] - 1;
+
+    idx = next;
+    next = rh_next(rh, next);
+  }
+
+  rh->dist[idx] = 0;
+  rh->count--;
+
+  // At the minimum capacity there is nothing to shrink to, and resizing would
+  // only rebuild the table as it is.
+  if (rh->base_capacity > HT_DEFAULT_CAPACITY &&
+      rh->count * 100 / rh->capacity < 20) {
+    rh_resize(rh, rh->base_capacity / 2);
+  }
+
+  return 1;
+}
+
+void rh_delete_table(rh_table *rh) {
+  for (unsigned int i = 0; i < rh->capacity; i++) {
+    if (rh->dist[i] != 0) {
+      rh_delete_entry(&rh->entries[i], &rh->opts, rh->free_value);
+    }
+  }
+
+  const hash_allocator allocator = rh->opts.allocator;
+
+  h_arena_free(rh->arena, &allocator);
+  h_free(&allocator, rh->entries, rh_buckets_size(rh->capacity));
+  h_free(&allocator, rh, sizeof(rh_table));
+}
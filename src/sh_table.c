@@ -0,0 +1,162 @@
+// pthread_rwlock_t is only declared by POSIX.1-2001 and later.
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "hash_table.h"
+#include "libhash.h"
+
+/**
+ * A shard: a hash table and the lock guarding it, aligned to a cache line of
+ * its own. Lookups hold the lock shared, as they do not modify the table.
+ */
+struct sh_shard {
+  _Alignas(H_CACHE_LINE) pthread_rwlock_t lock;
+  hash_table *ht;
+};
+
+static size_t sh_shards_size(const unsigned int shard_count) {
+  return shard_count * sizeof(struct sh_shard) + H_CACHE_LINE - 1;
+}
+
+/**
+ * The shard a key belongs to, picked by the high bits of its hash. Hash
+ * tables pick buckets and control tags by other bits, so each shard's
+ * buckets are filled as evenly as a single table's would be.
+ *
+ * @param sh
+ * @param hash
+ * @return struct sh_shard*
+ */
+static struct sh_shard *sh_shard_for(const sh_table *sh, const uint64_t hash) {
+  return &sh->shards[sh->shard_bits ? hash >> (64 - sh->shard_bits) : 0];
+}
+
+sh_table *sh_init(int base_capacity, free_fn *free_value) {
+  return sh_init_opts(base_capacity, free_value, NULL);
+}
+
+sh_table *sh_init_opts(int base_capacity, free_fn *free_value,
+                       const hash_opts *opts) {
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
+
+  sh_table *sh = h_alloc(&opts->allocator, sizeof(sh_table));
+  sh->opts = *opts;
+
+  const unsigned int requested =
+      opts->shards ? opts->shards : SH_DEFAULT_SHARDS;
+  sh->shard_count = 1;
+  sh->shard_bits = 0;
+  while (sh->shard_count < requested) {
+    sh->shard_count <<= 1;
+    sh->shard_bits++;
+  }
+
+  sh->shards_alloc =
+      h_alloc(&sh->opts.allocator, sh_shards_size(sh->shard_count));
+  sh->shards = h_cache_align(sh->shards_alloc);
+
+  // Hash tables clamp this to their own minimum.
+  base_capacity /= (int)sh->shard_count;
+
+  for (unsigned int i = 0; i < sh->shard_count; i++) {
+    struct sh_shard *s = &sh->shards[i];
+
+    pthread_rwlock_init(&s->lock, NULL);
+    s->ht = ht_init_opts(base_capacity, free_value, &sh->opts);
+  }
+
+  return sh;
+}
+
+void sh_insert(sh_table *sh, const char *key, void *value) {
+  sh_insert_n(sh, key, strlen(key), value);
+}
+
+void sh_insert_n(sh_table *sh, const void *key, size_t len, void *value) {
+  if (sh == NULL) {
+    return;
+  }
+
+  // Hashed once, both to pick the shard and by the shard's table.
+  const uint64_t hash = h_hash(key, len);
+  struct sh_shard *s = sh_shard_for(sh, hash);
+
+  pthread_rwlock_wrlock(&s->lock);
+  h_ht_insert(s->ht, key, len, hash, value);
+  pthread_rwlock_unlock(&s->lock);
+}
+
+void *sh_get(sh_table *sh, const char *key) {
+  return sh_get_n(sh, key, strlen(key));
+}
+
+void *sh_get_n(sh_table *sh, const void *key, size_t len) {
+  const uint64_t hash = h_hash(key, len);
+  struct sh_shard *s = sh_shard_for(sh, hash);
+
+  pthread_rwlock_rdlock(&s->lock);
+  const ht_entry *r = h_ht_search(s->ht, key, len, hash);
+  void *value = r ? r->value : NULL;
+  pthread_rwlock_unlock(&s->lock);
+
+  return value;
+}
+
+int sh_delete(sh_table *sh, const char *key) {
+  return sh_delete_n(sh, key, strlen(key));
+}
+
+int sh_delete_n(sh_table *sh, const void *key, size_t len) {
+  const uint64_t hash = h_hash(key, len);
+  struct sh_shard *s = sh_shard_for(sh, hash);
+
+  pthread_rwlock_wrlock(&s->lock);
+  const int deleted = h_ht_delete(s->ht, key, len, hash);
+  pthread_rwlock_unlock(&s->lock);
+
+  return deleted;
+}
+
+unsigned int sh_count(sh_table *sh) {
+  unsigned int count = 0;
+
+  for (unsigned int i = 0; i < sh->shard_count; i++) {
+    struct sh_shard *s = &sh->shards[i];
+
+    pthread_rwlock_rdlock(&s->lock);
+    count += s->ht->count;
+    pthread_rwlock_unlock(&s->lock);
+  }
+
+  return count;
+}
+
+void sh_get_stats(sh_table *sh, unsigned int shard, ht_stats *stats) {
+  struct sh_shard *s = &sh->shards[shard];
+
+  pthread_rwlock_rdlock(&s->lock);
+  ht_get_stats(s->ht, stats);
+  pthread_rwlock_unlock(&s->lock);
+}
+
+void sh_delete_table(sh_table *sh) {
+  const hash_allocator allocator = sh->opts.allocator;
+
+  for (unsigned int i = 0; i < sh->shard_count; i++) {
+    struct sh_shard *s = &sh->shards[i];
+
+    ht_delete_table(s->ht);
+    pthread_rwlock_destroy(&s->lock);
+  }
+
+  h_free(&allocator, sh->shards_alloc, sh_shards_size(sh->shard_count));
+  h_free(&allocator, sh, sizeof(sh_table));
+}
@@ -0,0 +1,264 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "group.h"
+#include "hash.h"
+#include "libhash.h"
+
+/**
+ * Find the bucket holding `key`. See `ht_find_bucket`; here the entries are
+ * stored inline, so a tag match reads the entry's key directly.
+ *
+ * @param ut
+ * @param key
+ * @param hash `h_hash_u64` digest of `key`
+ * @return int The bucket, or -1 if the key is not present
+ */
+static int u64_find_bucket(const u64_table *ut, const uint64_t key,
+                           const uint64_t hash) {
+  const uint8_t tag = h_ctrl_tag(hash);
+
+  h_group_probe probe;
+  unsigned int pos =
+      h_group_probe_start(&probe, hash, ut->capacity, &ut->reducer);
+
+  for (unsigned int i = h_group_probe_limit(ut->capacity); i > 0; i--) {
+    const h_group g = h_group_load(ut->ctrl + pos);
+
+    h_bitmask match = h_group_match(g, tag);
+    while (match) {
+      const unsigned int idx =
+          h_group_bucket(pos, h_bitmask_next(&match), ut->capacity);
+
+      if (ut->entries[idx].key == key) {
+        return (int)idx;
+      }
+    }
+
+    if (h_group_match_empty(g)) {
+      break;
+    }
+
+    pos = h_group_probe_next(&probe);
+  }
+
+  return -1;
+}
+
+/**
+ * Find the first empty or deleted bucket along the probe sequence for `hash`.
+ * The table's load limit guarantees there is one.
+ *
+ * @param ut
+ * @param hash
+ * @return unsigned int
+ */
+static unsigned int u64_find_free_bucket(const u64_table *ut,
+                                         const uint64_t hash) {
+  h_group_probe probe;
+  unsigned int pos =
+      h_group_probe_start(&probe, hash, ut->capacity, &ut->reducer);
+
+  for (;;) {
+    h_bitmask free_mask =
+        h_group_match_empty_or_deleted(h_group_load(ut->ctrl + pos));
+
+    if (free_mask) {
+      return h_group_bucket(pos, h_bitmask_next(&free_mask), ut->capacity);
+    }
+
+    pos = h_group_probe_next(&probe);
+  }
+}
+
+/**
+ * Place an entry whose key is not yet in the table.
+ *
+ * @param ut
+ * @param r
+ */
+static void u64_place_entry(u64_table *ut, const u64_entry *r) {
+  const uint64_t hash = h_hash_u64(r->key);
+  const unsigned int idx = u64_find_free_bucket(ut, hash);
+
+  if (ut->ctrl[idx] == H_CTRL_DELETED) {
+    ut->deleted--;
+  }
+
+  h_ctrl_set(ut->ctrl, ut->capacity, idx, h_ctrl_tag(hash));
+  ut->entries[idx] = *r;
+}
+
+/**
+ * Size in bytes of the buckets allocation for a capacity: the entries, then the
+ * control bytes.
+ *
+ * @param capacity
+ * @return size_t
+ */
+static size_t u64_buckets_size(const unsigned int capacity) {
+  return (size_t)capacity * sizeof(u64_entry) + capacity + H_GROUP_WIDTH - 1;
+}
+
+/**
+ * Allocate empty buckets for the given base capacity, replacing the table's
+ * current ones. The entries and control bytes share a single allocation owned
+ * by `entries`; the control bytes follow the entries so both stay aligned.
+ *
+ * @param ut
+ * @param base_capacity
+ */
+static void u64_init_buckets(u64_table *ut, const int base_capacity) {
+  ut->base_capacity = base_capacity;
+  ut->capacity = h_capacity(ut->base_capacity, ut->opts.pow2_capacity,
+                            &ut->reducer);
+
+  const size_t entries_size = (size_t)ut->capacity * sizeof(u64_entry);
+
+  ut->entries = h_alloc(&ut->opts.allocator, u64_buckets_size(ut->capacity));
+  ut->ctrl = (uint8_t *)ut->entries + entries_size;
+  memset(ut->ctrl, H_CTRL_EMPTY, (size_t)ut->capacity + H_GROUP_WIDTH - 1);
+  ut->deleted = 0;
+}
+
+/**
+ * Resize the table, re-placing every entry. The hash is a handful of
+ * arithmetic instructions on the key, so unlike `hash_table` entries carry no
+ * cached hash and it is simply recomputed. Resizing at the current capacity
+ * drops every deleted marker. See `ht_resize`.
+ *
+ * @param ut
+ * @param base_capacity
+ */
+static void u64_resize(u64_table *ut, int base_capacity) {
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  u64_entry *old_entries = ut->entries;
+  const uint8_t *old_ctrl = ut->ctrl;
+  const unsigned int old_capacity = ut->capacity;
+
+  u64_init_buckets(ut, base_capacity);
+
+  for (unsigned int pos = 0; pos < old_capacity; pos += H_GROUP_WIDTH) {
+    h_bitmask full = h_group_match_full(h_group_load(old_ctrl + pos));
+    if (old_capacity - pos < H_GROUP_WIDTH) {
+      full &= (1u << (old_capacity - pos)) - 1;
+    }
+
+    while (full) {
+      u64_place_entry(ut, &old_entries[pos + h_bitmask_next(&full)]);
+    }
+  }
+
+  h_free(&ut->opts.allocator, old_entries, u64_buckets_size(old_capacity));
+}
+
+u64_table *u64_init(int base_capacity, free_fn *free_value) {
+  return u64_init_opts(base_capacity, free_value, NULL);
+}
+
+u64_table *u64_init_opts(int base_capacity, free_fn *free_value,
+                         const hash_opts *opts) {
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  const hash_opts defaults = {0};
+  if (opts == NULL) {
+    opts = &defaults;
+  }
+
+  u64_table *ut = h_alloc(&opts->allocator, sizeof(u64_table));
+  ut->opts = *opts;
+
+  u64_init_buckets(ut, base_capacity);
+
+  ut->count = 0;
+  ut->free_value = free_value;
+
+  return ut;
+}
+
+void u64_insert(u64_table *ut, uint64_t key, void *value) {
+  if (ut == NULL) {
+    return;
+  }
+
+  // Updating an existing key never reallocates.
+  const int existing_idx = u64_find_bucket(ut, key, h_hash_u64(key));
+  if (existing_idx != -1) {
+    u64_entry *r = &ut->entries[existing_idx];
+    if (ut->free_value && r->value && r->value != value) {
+      ut->free_value(r->value);
+    }
+    r->value = value;
+    return;
+  }
+
+  // The same growth and purge limits as hash_table; see `__ht_insert`.
+  const unsigned int load = ut->count * 100 / ut->capacity;
+  if (load > 70) {
+    u64_resize(ut, ut->base_capacity * 2);
+  } else if ((ut->count + ut->deleted) * 100 / ut->capacity > 70 &&
+             ut->deleted * 100 / ut->capacity >= 15) {
+    u64_resize(ut, ut->base_capacity);
+  }
+
+  const u64_entry r = {.key = key, .value = value};
+  u64_place_entry(ut, &r);
+  ut->count++;
+}
+
+u64_entry *u64_search(u64_table *ut, uint64_t key) {
+  const int idx = u64_find_bucket(ut, key, h_hash_u64(key));
+
+  return idx == -1 ? NULL : &ut->entries[idx];
+}
+
+void *u64_get(u64_table *ut, uint64_t key) {
+  u64_entry *r = u64_search(ut, key);
+  return r ? r->value : NULL;
+}
+
+int u64_delete(u64_table *ut, uint64_t key) {
+  const int idx = u64_find_bucket(ut, key, h_hash_u64(key));
+  if (idx == -1) {
+    return 0;
+  }
+
+  u64_entry *r = &ut->entries[idx];
+  if (ut->free_value && r->value) {
+    ut->free_value(r->value);
+  }
+
+  h_ctrl_set(ut->ctrl, ut->capacity, idx, H_CTRL_DELETED);
+  ut->deleted++;
+  ut->count--;
+
+  // At the minimum capacity there is nothing to shrink to, and resizing would
+  // only rebuild the table as it is.
+  if (ut->base_capacity > HT_DEFAULT_CAPACITY &&
+      ut->count * 100 / ut->capacity < 30) {
+    u64_resize(ut, ut->base_capacity / 2);
+  }
+
+  return 1;
+}
+
+void u64_delete_table(u64_table *ut) {
+  if (ut->free_value) {
+    U64_ITER_START(ut)
+    if (entry->value) {
+      ut->free_value(entry->value);
+    }
+    U64_ITER_END
+  }
+
+  const hash_allocator allocator = ut->opts.allocator;
+
+  h_free(&allocator, ut->entries, u64_buckets_size(ut->capacity));
+  h_free(&allocator, ut, sizeof(u64_table));
+}
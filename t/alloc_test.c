@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+typedef struct {
+  size_t live;
+  unsigned int calls;
+} counting_ctx;
+
+static void *counting_alloc(void *ctx, size_t size) {
+  counting_ctx *c = ctx;
+  c->live += size;
+  c->calls++;
+  return malloc(size);
+}
+
+static void *counting_resize(void *ctx, void *ptr, size_t old_size,
+                             size_t size) {
+  counting_ctx *c = ctx;
+  c->live += size - old_size;
+  c->calls++;
+  return realloc(ptr, size);
+}
+
+static void counting_release(void *ctx, void *ptr, size_t size) {
+  counting_ctx *c = ctx;
+  c->live -= size;
+  c->calls++;
+  free(ptr);
+}
+
+static hash_opts counting_opts(counting_ctx *ctx, bool arena_keys) {
+  hash_opts opts = {.arena_keys = arena_keys,
+                    .allocator = {.alloc = counting_alloc,
+                                  .resize = counting_resize,
+                                  .release = counting_release,
+                                  .ctx = ctx}};
+  return opts;
+}
+
+static void test_alloc_hash_table(bool arena_keys) {
+  counting_ctx ctx = {0};
+  hash_opts opts = counting_opts(&ctx, arena_keys);
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    ht_insert(ht, key, "v");
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    snprintf(key, sizeof(key), "k%d", i);
+    ht_delete(ht, key);
+  }
+
+  ok(ctx.calls > 0 && ctx.live > 0, "hash table allocates through the "
+                                    "allocator (arena keys: %d)",
+     arena_keys);
+
+  ht_delete_table(ht);
+  ok(ctx.live == 0, "hash table releases everything it allocated "
+                    "(arena keys: %d)",
+     arena_keys);
+}
+
+static void test_alloc_incremental_rehash(void) {
+  counting_ctx ctx = {0};
+  hash_opts opts = counting_opts(&ctx, false);
+  opts.rehash_step = 1;
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+
+  char key[16];
+  for (int i = 0; i < 200; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    ht_insert(ht, key, "v");
+  }
+
+  // Tear down mid-migration, with the old index still allocated.
+  ht_delete_table(ht);
+  ok(ctx.live == 0, "hash table releases a pending rehash's old index");
+}
+
+static void test_alloc_hash_set(bool arena_keys) {
+  counting_ctx ctx = {0};
+  hash_opts opts = counting_opts(&ctx, arena_keys);
+  hash_set *hs = hs_init_opts(0, &opts);
+
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    hs_insert(hs, key);
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    snprintf(key, sizeof(key), "k%d", i);
+    hs_delete(hs, key);
+  }
+
+  ok(ctx.calls > 0, "hash set allocates through the allocator");
+
+  hs_delete_set(hs);
+  ok(ctx.live == 0, "hash set releases everything it allocated "
+                    "(arena keys: %d)",
+     arena_keys);
+}
+
+static void test_alloc_rh_table(void) {
+  counting_ctx ctx = {0};
+  hash_opts opts = counting_opts(&ctx, false);
+  rh_table *rh = rh_init_opts(0, NULL, &opts);
+
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    rh_insert(rh, key, "v");
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    snprintf(key, sizeof(key), "k%d", i);
+    rh_delete(rh, key);
+  }
+
+  ok(ctx.calls > 0, "Robin Hood table allocates through the allocator");
+
+  rh_delete_table(rh);
+  ok(ctx.live == 0, "Robin Hood table releases everything it allocated");
+}
+
+static void test_alloc_u64_table(void) {
+  counting_ctx ctx = {0};
+  hash_opts opts = counting_opts(&ctx, false);
+  u64_table *ut = u64_init_opts(0, NULL, &opts);
+
+  for (uint64_t i = 0; i < 1000; i++) {
+    u64_insert(ut, i, "v");
+  }
+  for (uint64_t i = 0; i < 1000; i += 2) {
+    u64_delete(ut, i);
+  }
+
+  ok(ctx.calls > 0, "integer-keyed table allocates through the allocator");
+
+  u64_delete_table(ut);
+  ok(ctx.live == 0, "integer-keyed table releases everything it allocated");
+}
+
+// A bump allocator over a static buffer, freed all at once by resetting it.
+// Passing any of its memory to libc's realloc or free would crash.
+static unsigned char pool[1 << 22];
+static size_t pool_used;
+
+static void *pool_alloc(void *ctx, size_t size) {
+  (void)ctx;
+  void *p = pool + pool_used;
+  pool_used += (size + 15) & ~(size_t)15;
+  return pool_used <= sizeof(pool) ? p : NULL;
+}
+
+static void test_alloc_pool(void) {
+  hash_opts opts = {.allocator = {.alloc = pool_alloc}};
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+  hash_set *hs = hs_init_opts(0, &opts);
+
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    ht_insert(ht, key, "v");
+    hs_insert(hs, key);
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    snprintf(key, sizeof(key), "k%d", i);
+    ht_delete(ht, key);
+    hs_delete(hs, key);
+  }
+
+  ok(ht_get(ht, "k999") != NULL && hs_contains(hs, "k999") &&
+         pool_used > 0,
+     "tables grow through an allocator with only alloc set");
+
+  lives(
+      {
+        ht_delete_table(ht);
+        hs_delete_set(hs);
+      },
+      "never hands an allocator's memory to free when it has no release");
+  pool_used = 0;
+}
+
+void run_alloc_tests(void) {
+  test_alloc_hash_table(false);
+  test_alloc_hash_table(true);
+  test_alloc_incremental_rehash();
+  test_alloc_hash_set(false);
+  test_alloc_hash_set(true);
+  test_alloc_rh_table();
+  test_alloc_u64_table();
+  test_alloc_pool();
+}
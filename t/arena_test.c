@@ -0,0 +1,29 @@
+#include <string.h>
+
+#include "arena.h"
+#include "tests.h"
+
+static void test_arena_alloc(void) {
+  struct h_arena_chunk *arena = NULL;
+  hash_allocator std = {0};
+
+  char *a = h_arena_alloc(&arena, 3, &std);
+  char *b = h_arena_alloc(&arena, 5, &std);
+  ok(arena != NULL && arena->size == H_ARENA_CHUNK_SIZE,
+     "allocates the first chunk on demand");
+  ok(b == a + 3 && arena->used == 8, "bumps allocations within a chunk");
+
+  h_arena_alloc(&arena, H_ARENA_CHUNK_SIZE - 8, &std);
+  h_arena_alloc(&arena, 1, &std);
+  ok(arena->size == H_ARENA_CHUNK_SIZE * 2 && arena->next != NULL,
+     "doubles the size of each new chunk");
+
+  char *big = h_arena_alloc(&arena, H_ARENA_MAX_CHUNK_SIZE * 2, &std);
+  memset(big, 0, H_ARENA_MAX_CHUNK_SIZE * 2);
+  ok(arena->size == H_ARENA_MAX_CHUNK_SIZE * 2,
+     "fits an allocation larger than a chunk");
+
+  lives({ h_arena_free(arena, &std); }, "frees every chunk");
+}
+
+void run_arena_tests(void) { test_arena_alloc(); }
@@ -0,0 +1,291 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+#define CT_TEST_THREADS 8
+#define CT_TEST_KEYS_PER_THREAD 2000
+#define CT_TEST_HELPERS 3
+#define CT_TEST_HELPED_KEYS 20000
+
+static void test_ct_initialization(void) {
+  hash_opts opts = {.stripes = 5};
+  ct_table *ct = ct_init_opts(0, NULL, &opts);
+
+  ok(ct != NULL, "concurrent table is not NULL");
+  ok(ct->stripe_count == 8, "rounds the stripe count up to a power of two");
+  ok(ct_count(ct) == 0, "initial count is 0");
+
+  ht_stats stats;
+  ct_get_stats(ct, &stats);
+  ok(stats.capacity >= 8 * 16, "gives every stripe at least a group");
+
+  lives({ ct_delete_table(ct); }, "frees the concurrent table heap memory");
+
+  ct = ct_init(0, NULL);
+  ok(ct->stripe_count == CT_DEFAULT_STRIPES, "defaults the stripe count");
+  ct_delete_table(ct);
+}
+
+static void test_ct_insert(void) {
+  ct_table *ct = ct_init(0, NULL);
+
+  ct_insert(ct, "k1", "v1");
+  ct_insert_n(ct, "k2\0x", 4, "v2");
+  ok(ct_count(ct) == 2, "increments the count when keys are inserted");
+  is(ct_get(ct, "k1"), "v1", "retrieves the value");
+  is(ct_get_n(ct, "k2\0x", 4), "v2", "retrieves the value of a binary key");
+  ok(ct_get(ct, "k2") == NULL, "does not match a prefix of a binary key");
+
+  ct_insert(ct, "k1", "v3");
+  ok(ct_count(ct) == 2, "does not increment the count when a key is updated");
+  is(ct_get(ct, "k1"), "v3", "updates the value");
+
+  ct_delete_table(ct);
+}
+
+static void test_ct_delete(void) {
+  ct_table *ct = ct_init(0, NULL);
+
+  ct_insert(ct, "k1", "v1");
+  ct_insert(ct, "k2", "v2");
+
+  ok(ct_delete(ct, "k1") == 1, "returns 1 when the entry was deleted");
+  ok(ct_get(ct, "k1") == NULL, "does not find the deleted key");
+  ok(ct_delete(ct, "k1") == 0, "returns 0 when there is no such entry");
+  is(ct_get(ct, "k2"), "v2", "retains the remaining key");
+
+  ct_delete_table(ct);
+}
+
+static void test_ct_resize(void) {
+  hash_opts opts = {.stripes = 4, .pow2_capacity = true};
+  ct_table *ct = ct_init_opts(0, NULL, &opts);
+
+  ht_stats stats;
+  ct_get_stats(ct, &stats);
+  const unsigned int initial_capacity = stats.capacity;
+
+  char key[16];
+  for (uintptr_t i = 0; i < 2000; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    ct_insert(ct, key, (void *)(i + 1));
+  }
+
+  ct_get_stats(ct, &stats);
+  ok(stats.resizes > 0 && stats.capacity > initial_capacity,
+     "grows every stripe");
+  // No probe visits more than every group of its stripe.
+  ok(stats.count == 2000 && stats.mean_probe_groups >= 1 &&
+         stats.max_probe_groups <= (stats.capacity / 4 + 15) / 16,
+     "reports counts and probe lengths summed over the stripes");
+  ok(ct_help_resize(ct) == 0,
+     "leaves no stripe to migrate once the growing thread returns");
+
+  unsigned int found = 0;
+  for (uintptr_t i = 0; i < 2000; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    found += ct_get(ct, key) == (void *)(i + 1);
+  }
+  ok(found == 2000 && ct_count(ct) == 2000,
+     "retains every entry across resizes");
+
+  ct_delete_table(ct);
+}
+
+static void test_ct_churn(void) {
+  hash_opts opts = {.stripes = 1};
+  ct_table *ct = ct_init_opts(0, NULL, &opts);
+
+  ht_stats stats;
+  ct_get_stats(ct, &stats);
+  const unsigned int initial_capacity = stats.capacity;
+
+  // Keep a steady 4 live keys while cycling through many more, so deleted
+  // markers pile up unless they are purged.
+  char key[16];
+  for (unsigned int i = 0; i < 5000; i++) {
+    snprintf(key, sizeof(key), "k%u", i);
+    ct_insert(ct, key, "x");
+
+    if (i >= 4) {
+      snprintf(key, sizeof(key), "k%u", i - 4);
+      ct_delete(ct, key);
+    }
+  }
+
+  ok(ct_count(ct) == 4 && ct_get(ct, "k4999") != NULL,
+     "retains the live keys under churn");
+  ct_get_stats(ct, &stats);
+  ok(stats.capacity == initial_capacity && stats.purges > 0,
+     "purges deleted markers without growing");
+
+  ct_delete_table(ct);
+}
+
+static void test_ct_delete_with_free(void) {
+  ct_table *ct = ct_init(0, free);
+
+  ct_insert(ct, "k1", strdup("v1"));
+  ct_insert(ct, "k2", strdup("v2"));
+
+  ct_insert(ct, "k2", strdup("v3"));
+  is(ct_get(ct, "k2"), "v3", "replaces the value, freeing the old one");
+
+  ok(ct_delete(ct, "k1") == 1, "deletes an entry with a free function");
+  lives({ ct_delete_table(ct); }, "frees the remaining values");
+}
+
+typedef struct {
+  ct_table *ct;
+  unsigned int id;
+  unsigned int mismatches;
+} ct_worker;
+
+/**
+ * Insert a range of keys of its own, reading each back along with a key
+ * another thread inserts, then delete every other key of the range.
+ */
+static void *ct_worker_run(void *arg) {
+  ct_worker *w = arg;
+  char key[32];
+
+  for (uintptr_t i = 0; i < CT_TEST_KEYS_PER_THREAD; i++) {
+    snprintf(key, sizeof(key), "t%u-%u", w->id, (unsigned int)i);
+    ct_insert(w->ct, key, (void *)(i + 1));
+
+    if (ct_get(w->ct, key) != (void *)(i + 1)) {
+      w->mismatches++;
+    }
+
+    // Whatever another thread has got to, its values must be intact.
+    snprintf(key, sizeof(key), "t%u-%u", (w->id + 1) % CT_TEST_THREADS,
+             (unsigned int)i);
+    void *other = ct_get(w->ct, key);
+    if (other != NULL && other != (void *)(i + 1)) {
+      w->mismatches++;
+    }
+  }
+
+  for (unsigned int i = 0; i < CT_TEST_KEYS_PER_THREAD; i += 2) {
+    snprintf(key, sizeof(key), "t%u-%u", w->id, i);
+    if (ct_delete(w->ct, key) != 1) {
+      w->mismatches++;
+    }
+  }
+
+  return NULL;
+}
+
+static void test_ct_threads(void) {
+  // Few stripes and a small start, so threads contend and the table grows
+  // while they run.
+  hash_opts opts = {.stripes = 4};
+  ct_table *ct = ct_init_opts(0, NULL, &opts);
+
+  pthread_t threads[CT_TEST_THREADS];
+  ct_worker workers[CT_TEST_THREADS];
+  for (unsigned int i = 0; i < CT_TEST_THREADS; i++) {
+    workers[i] = (ct_worker){.ct = ct, .id = i};
+    pthread_create(&threads[i], NULL, ct_worker_run, &workers[i]);
+  }
+
+  unsigned int mismatches = 0;
+  for (unsigned int i = 0; i < CT_TEST_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    mismatches += workers[i].mismatches;
+  }
+
+  ok(mismatches == 0, "every thread reads back what was inserted");
+  ht_stats stats;
+  ct_get_stats(ct, &stats);
+  ok(stats.resizes > 0, "grows while threads are inserting");
+
+  unsigned int found = 0;
+  char key[32];
+  for (unsigned int t = 0; t < CT_TEST_THREADS; t++) {
+    for (uintptr_t i = 1; i < CT_TEST_KEYS_PER_THREAD; i += 2) {
+      snprintf(key, sizeof(key), "t%u-%u", t, (unsigned int)i);
+      found += ct_get(ct, key) == (void *)(i + 1);
+    }
+  }
+  ok(found == CT_TEST_THREADS * CT_TEST_KEYS_PER_THREAD / 2 &&
+         ct_count(ct) == found,
+     "retains exactly the entries no thread deleted");
+
+  ct_delete_table(ct);
+}
+
+typedef struct {
+  ct_table *ct;
+  atomic_bool *done;
+} ct_helper;
+
+/**
+ * Stand in for a worker pool, migrating stripes whenever the table grows.
+ */
+static void *ct_helper_run(void *arg) {
+  ct_helper *h = arg;
+
+  while (!atomic_load(h->done)) {
+    ct_help_resize(h->ct);
+  }
+
+  return NULL;
+}
+
+static void test_ct_help_resize(void) {
+  hash_opts opts = {.stripes = 16};
+  ct_table *ct = ct_init_opts(0, NULL, &opts);
+  atomic_bool done;
+  atomic_init(&done, false);
+
+  pthread_t threads[CT_TEST_HELPERS];
+  ct_helper helpers[CT_TEST_HELPERS];
+  for (unsigned int i = 0; i < CT_TEST_HELPERS; i++) {
+    helpers[i] = (ct_helper){.ct = ct, .done = &done};
+    pthread_create(&threads[i], NULL, ct_helper_run, &helpers[i]);
+  }
+
+  char key[16];
+  for (uintptr_t i = 0; i < CT_TEST_HELPED_KEYS; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    ct_insert(ct, key, (void *)(i + 1));
+  }
+
+  atomic_store(&done, true);
+  for (unsigned int i = 0; i < CT_TEST_HELPERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  ht_stats stats;
+  ct_get_stats(ct, &stats);
+  ok(stats.resizes > 0 && ct_help_resize(ct) == 0,
+     "finishes every migration while helpers take part");
+
+  unsigned int found = 0;
+  for (uintptr_t i = 0; i < CT_TEST_HELPED_KEYS; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    found += ct_get(ct, key) == (void *)(i + 1);
+  }
+  ok(found == CT_TEST_HELPED_KEYS && ct_count(ct) == found,
+     "retains every entry migrated by a helper");
+
+  ct_delete_table(ct);
+}
+
+void run_ct_table_tests(void) {
+  test_ct_initialization();
+  test_ct_insert();
+  test_ct_delete();
+  test_ct_resize();
+  test_ct_churn();
+  test_ct_delete_with_free();
+  test_ct_threads();
+  test_ct_help_resize();
+}
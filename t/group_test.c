@@ -0,0 +1,55 @@
+#include "group.h"
+
+#include <string.h>
+
+#include "tests.h"
+
+static void test_group_match(void) {
+  uint8_t ctrl[H_GROUP_WIDTH];
+  memset(ctrl, H_CTRL_EMPTY, sizeof(ctrl));
+
+  ctrl[0] = 0x11;
+  ctrl[3] = 0x22;
+  ctrl[9] = 0x11;
+  ctrl[15] = H_CTRL_DELETED;
+
+  const h_group g = h_group_load(ctrl);
+
+  ok(h_group_match(g, 0x11) == ((1u << 0) | (1u << 9)),
+     "matches every byte with the given tag");
+  ok(h_group_match(g, 0x33) == 0, "matches nothing for an absent tag");
+  ok(h_group_match_empty(g) == (0xFFFFu & ~((1u << 0) | (1u << 3) |
+                                            (1u << 9) | (1u << 15))),
+     "matches empty bytes only");
+  ok(h_group_match_empty_or_deleted(g) == (h_group_match_empty(g) | 1u << 15),
+     "matches empty and deleted bytes");
+  ok(h_group_match_full(g) == ((1u << 0) | (1u << 3) | (1u << 9)),
+     "matches occupied bytes only");
+}
+
+static void test_bitmask_next(void) {
+  h_bitmask mask = (1u << 2) | (1u << 7);
+
+  ok(h_bitmask_next(&mask) == 2, "pops the lowest set bit first");
+  ok(h_bitmask_next(&mask) == 7, "pops the next set bit");
+  ok(mask == 0, "clears the popped bits");
+}
+
+static void test_ctrl_mirror(void) {
+  const unsigned int capacity = 20;
+  uint8_t ctrl[20 + H_GROUP_WIDTH - 1];
+  memset(ctrl, H_CTRL_EMPTY, sizeof(ctrl));
+
+  h_ctrl_set(ctrl, capacity, 1, 0x42);
+  h_ctrl_set(ctrl, capacity, 19, 0x43);
+
+  ok(ctrl[capacity + 1] == 0x42, "mirrors the leading control bytes");
+  ok(h_group_match(h_group_load(ctrl + 19), 0x42) == 1u << 2,
+     "a group loaded at the end wraps around to the start");
+}
+
+void run_group_tests(void) {
+  test_group_match();
+  test_bitmask_next();
+  test_ctrl_mirror();
+}
@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdio.h>
 
+#include "hash.h"
 #include "libhash.h"
 #include "prime.h"
 #include "tests.h"
@@ -14,7 +15,8 @@ static void test_initialization(void) {
   ok(hs != NULL, "hash set is not NULL");
   ok(hs->base_capacity == capacity, "given base capacity has been set");
 
-  ok(hs->capacity == next_prime(capacity), "given base capacity has been set");
+  ok(hs->capacity == prime_ladder_ceil(capacity)->prime,
+     "given base capacity has been set");
 
   ok(hs->count == 0, "initial count is 0");
 
@@ -111,11 +113,50 @@ static void test_capacity(void) {
   }
 
   ok(hs->base_capacity == 46, "extends the base capacity");
-  ok(hs->capacity == next_prime(initial_cap * 2),
+  ok(hs->capacity == prime_ladder_ceil(initial_cap * 2)->prime,
      "extends the actual capacity");
   ok(hs->count == initial_cap, "maintains the count");
 }
 
+static void test_caches_hash(void) {
+  hash_set *hs = hs_init(10);
+  hs_insert(hs, "k1");
+
+  unsigned int matches = 0;
+  for (unsigned int i = 0; i < hs->capacity; i++) {
+    const hs_entry *r = &hs->entries[i];
+    matches += r->key != NULL && r->hash == h_hash_str("k1");
+  }
+
+  ok(matches == 1, "caches the key hash in the slot");
+
+  hs_delete_set(hs);
+}
+
+static void test_pow2_capacity(void) {
+  hash_opts opts = {.pow2_capacity = true};
+  hash_set *hs = hs_init_opts(20, &opts);
+
+  ok(hs->capacity == 32, "rounds the capacity up to a power of two");
+
+  char buf[16];
+  for (int i = 0; i < 100; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    hs_insert(hs, buf);
+  }
+
+  unsigned int found = 0;
+  for (int i = 0; i < 100; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += hs_contains(hs, buf);
+  }
+
+  ok(found == 100 && (hs->capacity & (hs->capacity - 1)) == 0,
+     "grows by powers of two and retains every key");
+
+  hs_delete_set(hs);
+}
+
 static void test_contains_miss(void) {
   hash_set *hs = hs_init(2);
 
@@ -125,11 +166,111 @@ static void test_contains_miss(void) {
   ok(hs_contains(hs, "key2") == 0, "does not contain the key");
 }
 
+static void test_delete_keeps_probe_chains(void) {
+  hash_set *hs = hs_init(0);
+  char buf[16];
+
+  // Over half full, so many keys were placed past another's slot.
+  for (int i = 0; i < 35; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    hs_insert(hs, buf);
+  }
+  for (int i = 0; i < 35; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    hs_delete(hs, buf);
+  }
+
+  unsigned int found = 0;
+  for (int i = 1; i < 35; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += hs_contains(hs, buf);
+  }
+  ok(found == 17, "finds keys placed past a deleted one");
+
+  // Keep a steady 20 live keys while cycling through many more, so deleted
+  // slots pile up unless they are purged.
+  const unsigned int capacity = hs->capacity;
+  for (int i = 100; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    hs_insert(hs, buf);
+
+    snprintf(buf, sizeof(buf), "k%d", i - 3);
+    hs_delete(hs, buf);
+  }
+  ok(hs->capacity == capacity && hs_contains(hs, "k4999") &&
+         hs->deleted * 100 / hs->capacity <= 70,
+     "purges deleted slots without growing");
+
+  hs_delete_set(hs);
+}
+
+static void test_binary_keys(void) {
+  hash_set *hs = hs_init(0);
+
+  const char k1[] = {'a', '\0', 'b'};
+  const char k2[] = {'a', '\0', 'c'};
+
+  hs_insert_n(hs, k1, sizeof(k1));
+  hs_insert_n(hs, k2, sizeof(k2));
+  hs_insert(hs, "a");
+
+  ok(hs->count == 3, "stores keys differing past an embedded NUL apart");
+  ok(hs_contains_n(hs, k2, sizeof(k2)) == 1, "contains a binary key");
+  ok(hs_contains_n(hs, "a", 1) == 1, "finds string keys by their length");
+  ok(hs_delete_n(hs, k1, sizeof(k1)) == 1 &&
+         hs_contains_n(hs, k1, sizeof(k1)) == 0,
+     "deletes a binary key");
+
+  hs_delete_set(hs);
+}
+
+static void test_borrow_keys(void) {
+  hash_opts opts = {.borrow_keys = true};
+  hash_set *hs = hs_init_opts(0, &opts);
+  char k1[] = "k1";
+  const char k2[] = {'k', '2'};
+
+  hs_insert(hs, k1);
+  hs_insert_n(hs, k2, sizeof(k2));
+
+  unsigned int borrowed = 0;
+  for (unsigned int i = 0; i < hs->capacity; i++) {
+    borrowed += hs->entries[i].key == k1 || hs->entries[i].key == k2;
+  }
+  ok(borrowed == 2, "stores the caller's keys without copying them");
+  ok(hs_contains_n(hs, "k2", 2) == 1, "finds a key that is not terminated");
+  ok(hs_delete(hs, "k1") == 1, "deletes a borrowed key without freeing it");
+
+  hs_delete_set(hs);
+}
+
+static void test_arena_keys(void) {
+  hash_opts opts = {.arena_keys = true};
+  hash_set *hs = hs_init_opts(0, &opts);
+  char k1[] = "k1";
+
+  hs_insert(hs, k1);
+  hs_insert(hs, "k2");
+  k1[1] = '3';
+
+  ok(hs_contains(hs, "k1") == 1 && hs_contains(hs, "k2") == 1,
+     "stores copies of the keys in the set's arena");
+  ok(hs_delete(hs, "k1") == 1, "deletes an arena key");
+
+  lives({ hs_delete_set(hs); }, "frees the arena");
+}
+
 void run_hash_set_tests(void) {
   test_initialization();
   test_insert();
   test_contains();
   test_delete();
   test_capacity();
+  test_caches_hash();
+  test_pow2_capacity();
   test_contains_miss();
+  test_delete_keeps_probe_chains();
+  test_binary_keys();
+  test_borrow_keys();
+  test_arena_keys();
 }
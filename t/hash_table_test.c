@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdio.h>
 
+#include "strdup/strdup.h"
 #include "tests.h"
 
 // include the entire source so we may test static functions
@@ -22,7 +23,10 @@ static void test_ht_initialization(void) {
   char *v = "value";
 
   hash_table *ht = ht_init(20, NULL);
-  ht_entry *r = ht_entry_init(k, v);
+  hash_opts opts = {0};
+  ht_entry entry;
+  ht_entry *r = &entry;
+  ht_entry_init(r, strdup(k), strlen(k), h_hash_str(k), v);
 
   ok(ht != NULL, "hash table is not NULL");
   ok(ht->base_capacity == HT_DEFAULT_CAPACITY,
@@ -34,8 +38,10 @@ static void test_ht_initialization(void) {
 
   is(r->key, k, "key match");
   is(r->value, v, "value match");
+  ok(r->hash == h_hash_str(k), "hash match");
 
-  lives({ ht_delete_entry(r, false); }, "frees the entry heap memory");
+  lives({ ht_delete_entry(r, &opts, NULL); }, "frees the entry heap memory");
+  ok(r->key == NULL, "releases the entry key");
 }
 
 static void test_ht_insert(void) {
@@ -69,6 +75,8 @@ static void test_ht_search(void) {
   hash_table *ht = init_test_ht();
 
   is(ht_search(ht, "k1")->value, "v1", "retrieves the value");
+  ok(ht_search(ht, "k1")->hash == h_hash_str("k1"),
+     "caches the key hash in the entry");
   // `ht_get`	is essentially a wrapper for `ht_search`
   is(ht_get(ht, "k2"), "v2", "retrieves the value");
   is(ht_get(ht, "k3"), "v3", "retrieves the value");
@@ -114,6 +122,473 @@ static void test_ht_capacity(void) {
   ok(ht->count == initial_cap, "maintains the count");
 }
 
+static void test_ht_resize(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  ht_insert(ht, "first", "x");
+  const char *first_key = ht_search(ht, "first")->key;
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, "x");
+  }
+  ok(ht_search(ht, "first")->key == first_key,
+     "moves entries across resizes without copying their keys");
+  ht_delete(ht, "first");
+
+  ok(ht->count == 500, "maintains the count across resizes");
+  ok(ht->capacity > 500, "grows the capacity");
+
+  unsigned int found = 0;
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_entry *r = ht_search(ht, buf);
+    found += r != NULL && strcmp(r->key, buf) == 0;
+  }
+  ok(found == 500, "retains every entry across resizes");
+
+  unsigned int deleted = 0;
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    deleted += ht_delete(ht, buf);
+  }
+  ok(deleted == 500, "deletes every entry across resizes");
+  ok(ht->count == 0, "count after deleting every entry");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_churn(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  // Keep a steady 20 live keys while cycling through thousands, so deleted
+  // buckets pile up throughout the table.
+  for (int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "c%d", i);
+    ht_insert(ht, buf, "x");
+
+    if (i >= 20) {
+      snprintf(buf, sizeof(buf), "c%d", i - 20);
+      ht_delete(ht, buf);
+    }
+  }
+
+  ok(ht->count == 20, "maintains the count under churn");
+
+  unsigned int found = 0;
+  for (int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "c%d", i);
+    found += ht_search(ht, buf) != NULL;
+  }
+  ok(found == 20, "finds only the live keys under churn");
+  is(ht_get(ht, "c4999"), "x", "retrieves the most recent key");
+  is(ht_get(ht, "c4979"), NULL, "does not retrieve a churned key");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_incremental_rehash(void) {
+  hash_opts opts = {.rehash_step = 4};
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+  char buf[16];
+
+  int n = 0;
+  while (ht->old_ctrl == NULL) {
+    snprintf(buf, sizeof(buf), "k%d", n++);
+    ht_insert(ht, buf, "x");
+  }
+
+  ok(ht->rehash_idx == opts.rehash_step,
+     "migrates rehash_step buckets in the operation that starts the rehash");
+  ok(ht->capacity > ht->old_capacity, "allocates the larger buckets up front");
+
+  unsigned int found = 0;
+  for (int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += ht_search(ht, buf) != NULL;
+  }
+  ok(found == (unsigned int)n, "finds every key while rehashing");
+
+  ok(ht_delete(ht, "k0") == 1, "deletes a key while rehashing");
+  is(ht_get(ht, "k0"), NULL, "does not find the key deleted while rehashing");
+
+  ht_insert(ht, "k1", "y");
+  is(ht_get(ht, "k1"), "y", "updates a key while rehashing");
+  ok(ht->count == (unsigned int)n - 1, "maintains the count while rehashing");
+
+  const unsigned int rehash_idx = ht->rehash_idx;
+  unsigned int iterated = 0;
+  HT_ITER_START(ht)
+  iterated += entry->key != NULL;
+  HT_ITER_END
+  ok(ht->rehash_idx == rehash_idx, "iterates without migrating buckets");
+  ok(iterated == ht->count, "iterates every entry");
+  ok(ht_rehash(ht, HT_REHASH_ALL) == 0, "has no rehash in progress");
+
+  found = 0;
+  for (int i = 1; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += ht_search(ht, buf) != NULL;
+  }
+  ok(found == (unsigned int)n - 1, "finds every key after rehashing");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_pow2_capacity(void) {
+  hash_opts opts = {.pow2_capacity = true, .rehash_step = 4};
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+  char buf[16];
+
+  ok(ht->capacity == 64, "rounds the capacity up to a power of two");
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, "x");
+  }
+  ht_rehash(ht, HT_REHASH_ALL);
+
+  ok((ht->capacity & (ht->capacity - 1)) == 0, "grows by powers of two");
+
+  unsigned int found = 0;
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += ht_search(ht, buf) != NULL;
+  }
+  ok(found == 500, "retains every entry across resizes");
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+  ok(ht->count == 0, "deletes every entry");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_purge(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  for (int i = 0; i < 36; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, "x");
+  }
+  for (int i = 0; i < 36; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+  ok(ht->deleted == 18, "counts the deleted markers");
+
+  const unsigned int capacity = ht->capacity;
+  ht_purge(ht);
+  ok(ht->deleted == 0 && ht->purges == 1 && ht->capacity == capacity,
+     "clears the deleted markers in place");
+
+  unsigned int found = 0, missing = 0;
+  for (int i = 0; i < 36; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    if (i % 2) {
+      found += ht_search(ht, buf) != NULL;
+    } else {
+      missing += ht_search(ht, buf) == NULL;
+    }
+  }
+  ok(found == 18, "retains every live key");
+  ok(missing == 18, "does not resurrect deleted keys");
+
+  unsigned int linked = 0;
+  HT_ITER_START(ht)
+  linked += ht_search(ht, entry->key) == entry;
+  HT_ITER_END
+  ok(linked == 18 && ht->entries_len == 18,
+     "compacts the entries array, keeping the index in step");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_churn_purges(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  // Hold the live load steady, under the growth limit, while cycling through
+  // many more keys than there are buckets.
+  for (int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, "x");
+
+    if (i >= 30) {
+      snprintf(buf, sizeof(buf), "k%d", i - 30);
+      ht_delete(ht, buf);
+    }
+  }
+
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+
+  ok(stats.purges > 0 && stats.resizes == 0,
+     "purges rather than resizing under churn");
+  ok((stats.count + stats.deleted) * 100 / stats.capacity <= 85,
+     "bounds the effective load under churn");
+  ok(stats.mean_probe_groups >= 1 &&
+         stats.max_probe_groups <= h_group_probe_limit(stats.capacity),
+     "reports probe lengths");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_sparse_deletes(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  // Stay under 30% load at the minimum capacity, deleting present and absent
+  // keys alike.
+  for (int round = 0; round < 10; round++) {
+    for (int i = 0; i < 10; i++) {
+      snprintf(buf, sizeof(buf), "k%d", i);
+      ht_insert(ht, buf, "x");
+    }
+    for (int i = 0; i < 15; i++) {
+      snprintf(buf, sizeof(buf), "k%d", i);
+      ht_delete(ht, buf);
+    }
+  }
+
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+
+  ok(stats.count == 0 && stats.capacity == HT_DEFAULT_CAPACITY &&
+         stats.resizes == 0,
+     "does not resize a sparse table at its minimum size");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_stats_mid_rehash(void) {
+  hash_opts opts = {.rehash_step = 1};
+  hash_table *ht = ht_init_opts(1000, NULL, &opts);
+  char buf[16];
+
+  int i = 0;
+  while (ht->old_ctrl == NULL) {
+    snprintf(buf, sizeof(buf), "k%d", i++);
+    ht_insert(ht, buf, "x");
+  }
+
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+
+  // Nearly every entry is still in the old index, and the new one is nearly
+  // empty, so its lookup misses there after a single group.
+  ok(stats.count == (unsigned int)i &&
+         stats.max_probe_groups < h_group_probe_limit(stats.capacity),
+     "measures entries still being migrated by their actual lookup");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_dense_order(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, "x");
+  }
+  for (int i = 0; i < 500; i += 3) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+
+  // Entries are visited newest first, skipping the deleted ones, regardless
+  // of the resizes along the way.
+  int expected = 499, in_order = 1;
+  HT_ITER_START(ht)
+  if (expected % 3 == 0) {
+    expected--;
+  }
+  snprintf(buf, sizeof(buf), "k%d", expected--);
+  in_order &= strcmp(entry->key, buf) == 0;
+  HT_ITER_END
+  ok(in_order && expected == 0, "iterates in reverse insertion order");
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+  ok(ht->count == 0 && ht->entries_len == 0,
+     "releases every position when drained");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_hole_runs(void) {
+  // Incremental resizes leave the entries array in place as the table shrinks.
+  hash_opts opts = {.rehash_step = 4};
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+  char buf[16];
+
+  for (int i = 0; i < 100; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, "x");
+  }
+  ht_purge(ht);
+
+  // Delete every other entry first, so the remaining deletes each merge the
+  // runs on both sides.
+  for (int i = 2; i < 99; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+  for (int i = 1; i < 99; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+
+  ok(ht->entries[1].hole_end == 98 && ht->entries[98].hole_end == 1,
+     "links the ends of a merged run of holes");
+
+  unsigned int iterated = 0;
+  HT_ITER_START(ht)
+  iterated++;
+  HT_ITER_END
+  ok(iterated == 2, "skips a run of holes while iterating");
+
+  ht_delete(ht, "k99");
+  ok(ht->entries_len == 1, "drops a run of holes at the end of the entries");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_borrow_keys(void) {
+  hash_opts opts = {.borrow_keys = true};
+  hash_table *ht = ht_init_opts(0, NULL, &opts);
+  char buf[500][8];
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf[i], sizeof(buf[i]), "k%d", i);
+    ht_insert(ht, buf[i], "x");
+  }
+
+  unsigned int borrowed = 0;
+  for (int i = 0; i < 500; i++) {
+    borrowed += ht_search(ht, buf[i])->key == buf[i];
+  }
+  ok(borrowed == 500, "stores the caller's keys without copying them");
+
+  unsigned int deleted = 0;
+  for (int i = 0; i < 500; i += 2) {
+    deleted += ht_delete(ht, buf[i]);
+  }
+  ok(deleted == 250 && ht_search(ht, buf[1])->key == buf[1],
+     "deletes borrowed keys without freeing them");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_arena_keys(void) {
+  hash_opts opts = {.arena_keys = true};
+  hash_table *ht = ht_init_opts(0, free, &opts);
+  char buf[16];
+
+  for (int i = 0; i < 2000; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_insert(ht, buf, strdup(buf));
+  }
+  for (int i = 0; i < 2000; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_delete(ht, buf);
+  }
+
+  unsigned int found = 0;
+  for (int i = 1; i < 2000; i += 2) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    ht_entry *r = ht_search(ht, buf);
+    found += r != NULL && strcmp(r->key, buf) == 0 &&
+             strcmp(r->value, buf) == 0;
+  }
+  ok(found == 1000, "stores copies of the keys in the table's arena");
+  ok(ht->arena != NULL && ht->arena->next != NULL,
+     "spreads the keys across arena chunks");
+
+  lives({ ht_delete_table(ht); }, "frees the arena and the values");
+}
+
+static void test_ht_update_in_place(void) {
+  hash_table *ht = ht_init(0, free);
+  char *v1 = strdup("v1");
+  char *v2 = strdup("v2");
+
+  ht_insert(ht, "k1", v1);
+  const char *key = ht_search(ht, "k1")->key;
+
+  ht_insert(ht, "k1", v1);
+  ok(ht_get(ht, "k1") == v1, "keeps a value that is stored again");
+
+  ht_insert(ht, "k1", v2);
+  ok(ht_get(ht, "k1") == v2 && ht_search(ht, "k1")->key == key,
+     "overwrites the value without replacing the key");
+  ok(ht->count == 1, "does not increment the count when a key is updated");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_get_or_insert(void) {
+  hash_table *ht = ht_init(0, NULL);
+  const char *words[] = {"a", "b", "a", "c", "a", "b"};
+  bool inserted;
+
+  void **slot = ht_get_or_insert(ht, "a", &inserted);
+  ok(inserted && *slot == NULL, "inserts a missing key with a NULL value");
+
+  const char *key = ht_search(ht, "a")->key;
+  slot = ht_get_or_insert(ht, "a", &inserted);
+  ok(!inserted && ht_search(ht, "a")->key == key,
+     "finds a present key without replacing it");
+
+  // Count occurrences in place, with the counts stored in the value slots.
+  for (unsigned int i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+    slot = ht_get_or_insert(ht, words[i], NULL);
+    *slot = (void *)((uintptr_t)*slot + 1);
+  }
+  ok((uintptr_t)ht_get(ht, "a") == 3 && (uintptr_t)ht_get(ht, "b") == 2 &&
+         (uintptr_t)ht_get(ht, "c") == 1,
+     "updates values through the returned slot");
+
+  const char bin[] = {'c', '\0'};
+  slot = ht_get_or_insert_n(ht, bin, sizeof(bin), &inserted);
+  ok(inserted && ht->count == 4, "inserts a binary key");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_binary_keys(void) {
+  hash_table *ht = ht_init(0, NULL);
+
+  // Keys that only differ after an embedded NUL, or in length.
+  const char k1[] = {'a', '\0', 'b'};
+  const char k2[] = {'a', '\0', 'c'};
+
+  ht_insert_n(ht, k1, sizeof(k1), "v1");
+  ht_insert_n(ht, k2, sizeof(k2), "v2");
+  ht_insert(ht, "a", "v3");
+
+  ok(ht->count == 3, "stores keys differing past an embedded NUL apart");
+  is(ht_get_n(ht, k1, sizeof(k1)), "v1", "retrieves a binary key");
+  is(ht_get_n(ht, k2, sizeof(k2)), "v2", "retrieves a second binary key");
+  ok(ht_search_n(ht, "a", 1) == ht_search(ht, "a"),
+     "finds string keys by their length");
+  ok(ht_search_n(ht, k1, 2) == NULL, "does not match a key's prefix");
+
+  ok(ht_delete_n(ht, k1, sizeof(k1)) == 1, "deletes a binary key");
+  ok(ht_get_n(ht, k1, sizeof(k1)) == NULL && ht->count == 2,
+     "leaves the other keys in place");
+
+  ht_delete_table(ht);
+}
+
 static void test_ht_delete_with_free(void) {
   hash_table *ht = ht_init(10, free);
 
@@ -192,6 +667,21 @@ void run_hash_table_tests(void) {
   test_ht_search();
   test_ht_delete();
   test_ht_capacity();
+  test_ht_resize();
+  test_ht_churn();
+  test_ht_incremental_rehash();
+  test_ht_pow2_capacity();
+  test_ht_purge();
+  test_ht_churn_purges();
+  test_ht_sparse_deletes();
+  test_ht_stats_mid_rehash();
+  test_ht_dense_order();
+  test_ht_hole_runs();
+  test_ht_borrow_keys();
+  test_ht_arena_keys();
+  test_ht_update_in_place();
+  test_ht_get_or_insert();
+  test_ht_binary_keys();
   test_ht_delete_with_free();
   test_ht_iterate();
   test_hash_bugfix_1();
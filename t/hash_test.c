@@ -0,0 +1,122 @@
+#include "hash.h"
+
+#include <string.h>
+
+#include "tests.h"
+
+static void test_hash_deterministic(void) {
+  const char *k = "Content-Type";
+
+  ok(h_hash(k, strlen(k)) == h_hash(k, strlen(k)),
+     "hashes the same key to the same value");
+  ok(h_hash("k1", 2) != h_hash("k2", 2), "distinguishes differing keys");
+  ok(h_hash("k1", 2) != h_hash("k1", 1), "takes the length into account");
+  ok(h_hash("", 0) == h_hash("", 0), "hashes the empty key");
+}
+
+static void test_hash_all_lengths(void) {
+  // Flip the last byte of every key length up to 128 bytes so we exercise the
+  // small-key, 16-byte and 48-byte lanes as well as every tail size.
+  char buf[128];
+  memset(buf, 'a', sizeof(buf));
+
+  unsigned int collisions = 0;
+  for (size_t len = 1; len <= sizeof(buf); len++) {
+    const uint64_t h1 = h_hash(buf, len);
+    buf[len - 1] = 'b';
+    const uint64_t h2 = h_hash(buf, len);
+    buf[len - 1] = 'a';
+
+    if (h1 == h2) {
+      collisions++;
+    }
+  }
+
+  ok(collisions == 0, "every byte of every key length affects the hash");
+}
+
+static void test_probe_sequence(void) {
+  hash_reducer reducer;
+  const unsigned int capacity = h_capacity(53, false, &reducer);
+  unsigned int visited[53] = {0};
+  unsigned int out_of_range = 0;
+
+  h_probe probe;
+  unsigned int idx =
+      h_probe_start(&probe, h_hash_str("k1"), capacity, &reducer);
+  for (unsigned int attempt = 0; attempt < capacity; attempt++) {
+    if (idx >= capacity) {
+      out_of_range++;
+    } else {
+      visited[idx]++;
+    }
+    idx = h_probe_next(&probe);
+  }
+
+  unsigned int distinct = 0;
+  for (unsigned int i = 0; i < capacity; i++) {
+    distinct += visited[i] == 1;
+  }
+
+  ok(out_of_range == 0, "resolves every probe attempt within the capacity");
+  ok(distinct == capacity, "visits every slot of a prime capacity once");
+  ok(idx == h_probe_start(&probe, h_hash_str("k1"), capacity, &reducer),
+     "wraps around to the first index");
+}
+
+static void test_pow2_capacity(void) {
+  hash_reducer reducer;
+
+  ok(h_capacity(53, true, &reducer) == 64 && reducer.shift == 58,
+     "rounds up to a power of two");
+  ok(h_capacity(64, true, &reducer) == 64, "keeps an exact power of two");
+  ok(h_capacity(53, false, &reducer) == 53 && reducer.shift == 0,
+     "resolves a prime capacity without a shift");
+
+  const unsigned int capacity = h_capacity(50, true, &reducer);
+  unsigned int visited[64] = {0};
+
+  h_probe probe;
+  unsigned int idx =
+      h_probe_start(&probe, h_hash_str("k1"), capacity, &reducer);
+  for (unsigned int attempt = 0; attempt < capacity; attempt++) {
+    visited[idx]++;
+    idx = h_probe_next(&probe);
+  }
+
+  unsigned int distinct = 0;
+  for (unsigned int i = 0; i < capacity; i++) {
+    distinct += visited[i] == 1;
+  }
+
+  ok(distinct == capacity, "visits every slot of a power-of-two capacity once");
+}
+
+static void test_reduce_prime(void) {
+  const unsigned int bases[] = {2, 53, 1000, 100000, 1u << 30};
+  unsigned int mismatches = 0;
+
+  for (unsigned int i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+    hash_reducer reducer;
+    const unsigned int capacity = h_capacity((int)bases[i], false, &reducer);
+
+    uint64_t hash = 1;
+    for (unsigned int j = 0; j < 10000; j++) {
+      hash = hash * H_FIBONACCI + j;
+      mismatches += h_reduce(hash, capacity, &reducer) !=
+                    (uint32_t)hash % capacity;
+    }
+    mismatches += h_reduce(UINT32_MAX, capacity, &reducer) !=
+                  UINT32_MAX % capacity;
+  }
+
+  ok(mismatches == 0, "reduces modulo a prime capacity without dividing");
+}
+
+void run_hash_tests(void) {
+  test_hash_deterministic();
+  test_hash_all_lengths();
+  test_probe_sequence();
+  test_pow2_capacity();
+  test_reduce_prime();
+}
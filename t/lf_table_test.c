@@ -0,0 +1,219 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+#define LF_TEST_READERS 4
+#define LF_TEST_KEYS 256
+#define LF_TEST_ROUNDS 20
+
+static unsigned int freed_values;
+
+static void count_free(void *value) {
+  freed_values++;
+  free(value);
+}
+
+static void test_lf_insert(void) {
+  lf_table *lf = lf_init(0, NULL);
+  lf_thread *self = lf_thread_register(lf);
+
+  ok(lf != NULL && lf_count(lf) == 0, "initial count is 0");
+
+  lf_insert(lf, "k1", "v1");
+  lf_insert_n(lf, "k2\0x", 4, "v2");
+  ok(lf_count(lf) == 2, "increments the count when keys are inserted");
+  is(lf_get(lf, "k1"), "v1", "retrieves the value");
+  is(lf_get_n(lf, "k2\0x", 4), "v2", "retrieves the value of a binary key");
+  ok(lf_get(lf, "k2") == NULL, "does not match a prefix of a binary key");
+
+  lf_insert(lf, "k1", "v3");
+  ok(lf_count(lf) == 2, "does not increment the count when a key is updated");
+  is(lf_get(lf, "k1"), "v3", "updates the value");
+
+  ok(lf_delete(lf, "k1") == 1, "returns 1 when the entry was deleted");
+  ok(lf_get(lf, "k1") == NULL, "does not find the deleted key");
+  ok(lf_delete(lf, "k1") == 0, "returns 0 when there is no such entry");
+
+  lf_insert(lf, "k1", "v4");
+  is(lf_get(lf, "k1"), "v4", "reinserts a deleted key");
+
+  lf_thread_unregister(self);
+  lives({ lf_delete_table(lf); }, "frees the lock-free table heap memory");
+}
+
+static void test_lf_resize(void) {
+  lf_table *lf = lf_init(0, NULL);
+
+  char key[16];
+  for (uintptr_t i = 0; i < 2000; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    lf_insert(lf, key, (void *)(i + 1));
+  }
+
+  ok(lf->resizes > 0 && lf->base_capacity > HT_DEFAULT_CAPACITY,
+     "grows the bucket array");
+
+  unsigned int found = 0;
+  for (uintptr_t i = 0; i < 2000; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    found += lf_get(lf, key) == (void *)(i + 1);
+  }
+  ok(found == 2000 && lf_count(lf) == 2000,
+     "retains every entry across resizes");
+
+  lf_delete_table(lf);
+}
+
+static void test_lf_churn(void) {
+  lf_table *lf = lf_init(0, NULL);
+
+  // Keep a steady 4 live keys while cycling through many more, so tombstones
+  // pile up unless they are purged.
+  char key[16];
+  for (unsigned int i = 0; i < 5000; i++) {
+    snprintf(key, sizeof(key), "k%u", i);
+    lf_insert(lf, key, "x");
+
+    if (i >= 4) {
+      snprintf(key, sizeof(key), "k%u", i - 4);
+      lf_delete(lf, key);
+    }
+  }
+
+  ok(lf_count(lf) == 4 && lf_get(lf, "k4999") != NULL,
+     "retains the live keys under churn");
+  ok(lf->resizes > 0 && lf->base_capacity == HT_DEFAULT_CAPACITY,
+     "purges tombstones without growing");
+
+  lf_delete_table(lf);
+}
+
+static void test_lf_reclamation(void) {
+  lf_table *lf = lf_init(0, count_free);
+  lf_thread *reader = lf_thread_register(lf);
+
+  lf_insert(lf, "k", strdup("v0"));
+  char *held = lf_get(lf, "k");
+
+  freed_values = 0;
+  char key[16];
+  for (unsigned int i = 0; i < 200; i++) {
+    snprintf(key, sizeof(key), "v%u", i + 1);
+    lf_insert(lf, "k", strdup(key));
+  }
+
+  ok(freed_values == 0, "frees no replaced value while a reader may hold it");
+  is(held, "v0", "keeps a held value intact");
+
+  lf_quiescent(reader);
+  lf_insert(lf, "k", strdup("last"));
+  for (unsigned int i = 0; i < 100; i++) {
+    lf_delete(lf, "k");
+    lf_insert(lf, "k", strdup("again"));
+  }
+  ok(freed_values > 0, "frees replaced values once the reader is quiescent");
+
+  lf_thread_unregister(reader);
+  lf_thread *reused = lf_thread_register(lf);
+  ok(reused == reader, "reuses an unregistered thread's record");
+  lf_thread_unregister(reused);
+
+  lf_delete_table(lf);
+}
+
+typedef struct {
+  lf_table *lf;
+  atomic_bool *done;
+  unsigned int mismatches;
+  unsigned int hits;
+} lf_reader;
+
+/**
+ * Look keys up until the writer is done, checking every value found still
+ * holds its key's number. A value freed too early would not, or would trip a
+ * sanitizer.
+ */
+static void *lf_reader_run(void *arg) {
+  lf_reader *r = arg;
+  lf_thread *self = lf_thread_register(r->lf);
+  char key[16];
+
+  while (!atomic_load(r->done)) {
+    for (unsigned int i = 0; i < LF_TEST_KEYS; i++) {
+      snprintf(key, sizeof(key), "k%u", i);
+      const unsigned int *value = lf_get(r->lf, key);
+
+      if (value != NULL) {
+        r->hits++;
+        r->mismatches += *value != i;
+      }
+    }
+
+    lf_quiescent(self);
+  }
+
+  lf_thread_unregister(self);
+  return NULL;
+}
+
+static unsigned int *lf_test_value(unsigned int i) {
+  unsigned int *value = malloc(sizeof(unsigned int));
+  *value = i;
+  return value;
+}
+
+static void test_lf_threads(void) {
+  lf_table *lf = lf_init(0, free);
+  atomic_bool done;
+  atomic_init(&done, false);
+
+  pthread_t threads[LF_TEST_READERS];
+  lf_reader readers[LF_TEST_READERS];
+  for (unsigned int i = 0; i < LF_TEST_READERS; i++) {
+    readers[i] = (lf_reader){.lf = lf, .done = &done};
+    pthread_create(&threads[i], NULL, lf_reader_run, &readers[i]);
+  }
+
+  // Insert, update and delete every key, many times over, resizing as the
+  // table fills with tombstones.
+  char key[16];
+  for (unsigned int round = 0; round < LF_TEST_ROUNDS; round++) {
+    for (unsigned int i = 0; i < LF_TEST_KEYS; i++) {
+      snprintf(key, sizeof(key), "k%u", i);
+      lf_insert(lf, key, lf_test_value(i));
+      lf_insert(lf, key, lf_test_value(i));
+    }
+    for (unsigned int i = round % 2; i < LF_TEST_KEYS; i += 2) {
+      snprintf(key, sizeof(key), "k%u", i);
+      lf_delete(lf, key);
+    }
+  }
+
+  atomic_store(&done, true);
+
+  unsigned int mismatches = 0;
+  for (unsigned int i = 0; i < LF_TEST_READERS; i++) {
+    pthread_join(threads[i], NULL);
+    mismatches += readers[i].mismatches;
+  }
+
+  ok(mismatches == 0, "readers only ever see intact values");
+  ok(lf->resizes > 0, "replaces the bucket array while readers are reading");
+  ok(lf_count(lf) == LF_TEST_KEYS / 2, "counts the entries left");
+
+  lf_delete_table(lf);
+}
+
+void run_lf_table_tests(void) {
+  test_lf_insert();
+  test_lf_resize();
+  test_lf_churn();
+  test_lf_reclamation();
+  test_lf_threads();
+}
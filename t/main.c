@@ -2,12 +2,21 @@
 #include "tests.h"
 
 int main(void) {
-  plan(148);
+  plan(403);
 
+  run_hash_tests();
+  run_group_tests();
   run_hash_set_tests();
   run_hash_table_tests();
+  run_rh_table_tests();
+  run_u64_table_tests();
+  run_ct_table_tests();
+  run_lf_table_tests();
+  run_sh_table_tests();
+  run_map_tests();
+  run_arena_tests();
+  run_alloc_tests();
   run_prime_tests();
-  run_list_tests();
 
   done_testing();
 }
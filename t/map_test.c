@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libhash_map.h"
+#include "tests.h"
+
+LIBHASH_DEFINE_MAP(id_map, uint64_t, uint32_t, libhash_map_hash_u64,
+                   LIBHASH_MAP_EQ)
+
+LIBHASH_DEFINE_MAP(str_map, const char *, int, libhash_map_hash_str,
+                   LIBHASH_MAP_STR_EQ)
+
+static void test_map_insert(void) {
+  id_map m;
+  id_map_init(&m, 0);
+
+  ok(m.capacity == LIBHASH_MAP_MIN_CAPACITY, "starts at the minimum capacity");
+  ok(id_map_insert(&m, 42, 1) == 1, "returns 1 when a key is inserted");
+  ok(id_map_insert(&m, 42, 2) == 0, "returns 0 when a key is updated");
+  ok(m.count == 1 && *id_map_get(&m, 42) == 2, "updates the value in place");
+  ok(id_map_get(&m, 7) == NULL, "returns NULL for a missing key");
+
+  id_map_free(&m);
+}
+
+static void test_map_resize(void) {
+  id_map m;
+  id_map_init(&m, 0);
+
+  for (uint32_t i = 0; i < 1000; i++) {
+    id_map_insert(&m, (uint64_t)i << 32, i);
+  }
+
+  unsigned int found = 0;
+  for (uint32_t i = 0; i < 1000; i++) {
+    const uint32_t *v = id_map_get(&m, (uint64_t)i << 32);
+    found += v != NULL && *v == i;
+  }
+  ok(m.count == 1000 && found == 1000, "retains every entry across resizes");
+
+  unsigned int it = 0, iterated = 0;
+  for (id_map_entry *r; (r = id_map_next(&m, &it)) != NULL;) {
+    iterated += r->key >> 32 == r->value;
+  }
+  ok(iterated == 1000, "iterates every entry");
+
+  id_map_free(&m);
+}
+
+static void test_map_churn(void) {
+  id_map m;
+  id_map_init(&m, 0);
+
+  // Keep a steady 4 live keys; deleted markers must be cleared rather than
+  // growing the map.
+  for (uint32_t i = 0; i < 5000; i++) {
+    id_map_insert(&m, i, i);
+    if (i >= 4) {
+      id_map_delete(&m, i - 4);
+    }
+  }
+
+  ok(m.count == 4 && *id_map_get(&m, 4999) == 4999,
+     "retains the live keys under churn");
+  ok(m.capacity == LIBHASH_MAP_MIN_CAPACITY,
+     "clears deleted markers without growing");
+  ok(id_map_delete(&m, 0) == 0, "returns 0 when there is no such entry");
+
+  id_map_free(&m);
+}
+
+static void test_map_str_keys(void) {
+  str_map m;
+  str_map_init(&m, 100);
+
+  char k1[] = "key";
+  char k2[] = "key";
+
+  str_map_insert(&m, k1, 1);
+  str_map_insert(&m, "other", 2);
+
+  ok(m.capacity * 7 / 10 >= 100, "reserves room for the requested capacity");
+  ok(*str_map_get(&m, k2) == 1, "compares keys with the equality function");
+  ok(str_map_delete(&m, k2) == 1 && str_map_get(&m, k1) == NULL,
+     "deletes by an equal key");
+  ok(m.count == 1, "decrements the count");
+
+  str_map_free(&m);
+}
+
+void run_map_tests(void) {
+  test_map_insert();
+  test_map_resize();
+  test_map_churn();
+  test_map_str_keys();
+}
@@ -22,7 +22,23 @@ static void test_next_prime(void) {
   }
 }
 
+static void test_prime_ladder(void) {
+  ok(prime_ladder_ceil(53)->prime == 53, "keeps a capacity on the ladder");
+  ok(prime_ladder_ceil(54)->prime == 107, "rounds up to the next rung");
+  ok(prime_ladder_ceil(0)->prime == 2, "resolves the smallest rung");
+  ok(prime_ladder_ceil(UINT32_MAX)->prime == 4294967291u,
+     "clamps to the largest rung");
+
+  unsigned int bad = 0;
+  for (const prime_rung *r = prime_ladder_ceil(0); r->prime < 100000;
+       r = prime_ladder_ceil(r->prime + 1)) {
+    bad += !is_prime((int)r->prime) || r->magic != UINT64_MAX / r->prime + 1;
+  }
+  ok(bad == 0, "every rung is prime with a matching reciprocal");
+}
+
 void run_prime_tests(void) {
   test_is_prime();
   test_next_prime();
+  test_prime_ladder();
 }
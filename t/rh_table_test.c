@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+/**
+ * Check the Robin Hood invariants: every occupied bucket's distance places its
+ * entry relative to its home bucket, the number of occupied buckets is the
+ * count (i.e. there are no deleted markers), and a bucket's distance never
+ * exceeds its predecessor's by more than one.
+ */
+static bool rh_is_consistent(rh_table *rh) {
+  unsigned int occupied = 0;
+
+  for (unsigned int i = 0; i < rh->capacity; i++) {
+    const uint32_t dist = rh->dist[i];
+    if (dist == 0) {
+      continue;
+    }
+
+    occupied++;
+
+    const unsigned int home =
+        h_reduce(rh->entries[i].hash, rh->capacity, &rh->reducer);
+    if ((home + dist - 1) % rh->capacity != i) {
+      return false;
+    }
+
+    const unsigned int prev = i == 0 ? rh->capacity - 1 : i - 1;
+    if (dist > rh->dist[prev] + 1) {
+      return false;
+    }
+  }
+
+  return occupied == rh->count;
+}
+
+static void test_rh_initialization(void) {
+  rh_table *rh = rh_init(10, NULL);
+
+  ok(rh != NULL, "Robin Hood table is not NULL");
+  ok(rh->capacity == HT_DEFAULT_CAPACITY, "clamps to the default capacity");
+  ok(rh->count == 0, "initial count is 0");
+
+  lives({ rh_delete_table(rh); }, "frees the Robin Hood table heap memory");
+}
+
+static void test_rh_insert(void) {
+  rh_table *rh = rh_init(0, NULL);
+
+  rh_insert(rh, "k1", "v1");
+  rh_insert(rh, "k2", "v2");
+  ok(rh->count == 2, "increments the count when keys are inserted");
+  is(rh_get(rh, "k1"), "v1", "retrieves the inserted value");
+  is(rh_search(rh, "k2")->key, "k2", "stores the key");
+
+  rh_insert(rh, "k1", "v3");
+  ok(rh->count == 2, "does not increment the count when a key is updated");
+  is(rh_get(rh, "k1"), "v3", "updates the value");
+  ok(rh_search(rh, "k3") == NULL, "returns NULL for a missing key");
+
+  rh_delete_table(rh);
+}
+
+static void test_rh_delete(void) {
+  rh_table *rh = rh_init(0, NULL);
+
+  rh_insert(rh, "k1", "v1");
+  rh_insert(rh, "k2", "v2");
+
+  ok(rh_delete(rh, "k1") == 1, "returns 1 when the entry was deleted");
+  ok(rh_search(rh, "k1") == NULL, "does not find the deleted key");
+  ok(rh_delete(rh, "k1") == 0, "returns 0 when there is no such entry");
+  is(rh_get(rh, "k2"), "v2", "retains the remaining key");
+
+  const ht_entry *entries = rh->entries;
+  rh_delete(rh, "k3");
+  ok(rh->entries == entries, "does not rebuild a table at its minimum size");
+
+  rh_delete_table(rh);
+}
+
+static void test_rh_update_full(void) {
+  rh_table *rh = rh_init(0, NULL);
+  char buf[16];
+
+  int i = 0;
+  while (rh->count * 100 / rh->capacity <= 85) {
+    snprintf(buf, sizeof(buf), "k%d", i++);
+    rh_insert(rh, buf, "x");
+  }
+
+  const ht_entry *entries = rh->entries;
+  rh_insert(rh, "k0", "y");
+  ok(rh->entries == entries && rh_get(rh, "k0") != NULL,
+     "updates a key in a table due to grow without growing it");
+
+  snprintf(buf, sizeof(buf), "k%d", i);
+  rh_insert(rh, buf, "x");
+  ok(rh->entries != entries, "grows on the next new key");
+
+  rh_delete_table(rh);
+}
+
+static void test_rh_resize(void) {
+  rh_table *rh = rh_init(0, NULL);
+  char buf[16];
+
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    rh_insert(rh, buf, "x");
+  }
+
+  ok(rh->capacity > 500, "grows the capacity");
+
+  unsigned int found = 0;
+  for (int i = 0; i < 500; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += rh_search(rh, buf) != NULL;
+  }
+  ok(found == 500, "retains every entry across resizes");
+  ok(rh_is_consistent(rh), "keeps entries ordered by distance from home");
+
+  for (int i = 0; i < 490; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    rh_delete(rh, buf);
+  }
+  ok(rh->capacity < 500 && rh->count == 10, "shrinks as entries are deleted");
+  ok(rh_is_consistent(rh), "keeps entries ordered across shrinking");
+
+  rh_delete_table(rh);
+}
+
+static void test_rh_churn(void) {
+  hash_opts opts = {.pow2_capacity = true};
+  rh_table *rh = rh_init_opts(0, NULL, &opts);
+  char buf[16];
+
+  // Keep a steady 20 live keys while cycling through many more, so a table
+  // that left deleted markers behind would fill up with them.
+  for (int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    rh_insert(rh, buf, "x");
+
+    if (i >= 20) {
+      snprintf(buf, sizeof(buf), "k%d", i - 20);
+      rh_delete(rh, buf);
+    }
+  }
+
+  unsigned int found = 0;
+  for (int i = 4980; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "k%d", i);
+    found += rh_search(rh, buf) != NULL;
+  }
+
+  ok(rh->count == 20 && found == 20, "retains the live keys under churn");
+  ok(rh_is_consistent(rh), "leaves no deleted markers under churn");
+
+  rh_delete_table(rh);
+}
+
+static void test_rh_borrow_keys(void) {
+  hash_opts opts = {.borrow_keys = true};
+  rh_table *rh = rh_init_opts(0, NULL, &opts);
+  char key[] = "k1";
+
+  rh_insert(rh, key, "v1");
+  ok(rh_search(rh, "k1")->key == key,
+     "stores the caller's key without copying it");
+  ok(rh_delete(rh, "k1") == 1, "deletes a borrowed key without freeing it");
+
+  rh_delete_table(rh);
+}
+
+static void test_rh_delete_with_free(void) {
+  rh_table *rh = rh_init(0, free);
+
+  rh_insert(rh, "k1", strdup("v1"));
+  rh_insert(rh, "k2", strdup("v2"));
+
+  rh_insert(rh, "k2", strdup("v3"));
+  is(rh_get(rh, "k2"), "v3", "replaces the value, freeing the old one");
+
+  ok(rh_delete(rh, "k1") == 1, "deletes an entry with a free function");
+  lives({ rh_delete_table(rh); }, "frees the remaining values");
+}
+
+void run_rh_table_tests(void) {
+  test_rh_initialization();
+  test_rh_insert();
+  test_rh_delete();
+  test_rh_update_full();
+  test_rh_resize();
+  test_rh_churn();
+  test_rh_borrow_keys();
+  test_rh_delete_with_free();
+}
@@ -0,0 +1,191 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+#define SH_TEST_THREADS 8
+#define SH_TEST_KEYS_PER_THREAD 2000
+
+static void test_sh_initialization(void) {
+  hash_opts opts = {.shards = 3};
+  sh_table *sh = sh_init_opts(0, NULL, &opts);
+
+  ok(sh != NULL, "sharded table is not NULL");
+  ok(sh->shard_count == 4 && sh->shard_bits == 2,
+     "rounds the shard count up to a power of two");
+  ok(sh_count(sh) == 0, "initial count is 0");
+
+  lives({ sh_delete_table(sh); }, "frees the sharded table heap memory");
+
+  sh = sh_init(0, NULL);
+  ok(sh->shard_count == SH_DEFAULT_SHARDS, "defaults the shard count");
+  sh_delete_table(sh);
+
+  opts.shards = 1;
+  sh = sh_init_opts(0, NULL, &opts);
+  sh_insert(sh, "k1", "v1");
+  is(sh_get(sh, "k1"), "v1", "routes every key to a single shard");
+  sh_delete_table(sh);
+}
+
+static void test_sh_insert(void) {
+  sh_table *sh = sh_init(0, NULL);
+
+  sh_insert(sh, "k1", "v1");
+  sh_insert_n(sh, "k2\0x", 4, "v2");
+  ok(sh_count(sh) == 2, "increments the count when keys are inserted");
+  is(sh_get(sh, "k1"), "v1", "retrieves the value");
+  is(sh_get_n(sh, "k2\0x", 4), "v2", "retrieves the value of a binary key");
+
+  sh_insert(sh, "k1", "v3");
+  ok(sh_count(sh) == 2, "does not increment the count when a key is updated");
+  is(sh_get(sh, "k1"), "v3", "updates the value");
+
+  ok(sh_delete(sh, "k1") == 1, "returns 1 when the entry was deleted");
+  ok(sh_get(sh, "k1") == NULL, "does not find the deleted key");
+  ok(sh_delete(sh, "k1") == 0, "returns 0 when there is no such entry");
+
+  sh_delete_table(sh);
+}
+
+static void test_sh_stats(void) {
+  hash_opts opts = {.shards = 8};
+  sh_table *sh = sh_init_opts(0, NULL, &opts);
+
+  char key[16];
+  for (uintptr_t i = 0; i < 4000; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    sh_insert(sh, key, (void *)(i + 1));
+  }
+
+  unsigned int found = 0;
+  for (uintptr_t i = 0; i < 4000; i++) {
+    snprintf(key, sizeof(key), "k%u", (unsigned int)i);
+    found += sh_get(sh, key) == (void *)(i + 1);
+  }
+  ok(found == 4000, "retains every entry across shard resizes");
+
+  unsigned int total = 0, empty = 0, resized = 0;
+  for (unsigned int i = 0; i < sh->shard_count; i++) {
+    ht_stats stats;
+    sh_get_stats(sh, i, &stats);
+
+    total += stats.count;
+    empty += stats.count == 0;
+    resized += stats.resizes > 0;
+  }
+
+  ok(total == 4000 && total == sh_count(sh),
+     "reports each shard's count in its stats");
+  ok(empty == 0, "spreads keys across every shard");
+  ok(resized == sh->shard_count, "resizes each shard on its own");
+
+  sh_delete_table(sh);
+}
+
+static void test_sh_steady_churn(void) {
+  sh_table *sh = sh_init(0, NULL);
+
+  char key[16];
+  for (unsigned int i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "k%u", i);
+    sh_insert(sh, key, "v");
+    sh_delete(sh, key);
+  }
+
+  unsigned int resizes = 0;
+  for (unsigned int i = 0; i < sh->shard_count; i++) {
+    ht_stats stats;
+    sh_get_stats(sh, i, &stats);
+
+    resizes += stats.resizes;
+  }
+
+  ok(sh_count(sh) == 0 && resizes == 0,
+     "does not resize shards under steady inserts and deletes");
+
+  sh_delete_table(sh);
+}
+
+static void test_sh_delete_with_free(void) {
+  sh_table *sh = sh_init(0, free);
+
+  sh_insert(sh, "k1", strdup("v1"));
+  sh_insert(sh, "k2", strdup("v2"));
+
+  sh_insert(sh, "k2", strdup("v3"));
+  is(sh_get(sh, "k2"), "v3", "replaces the value, freeing the old one");
+
+  ok(sh_delete(sh, "k1") == 1, "deletes an entry with a free function");
+  lives({ sh_delete_table(sh); }, "frees the remaining values");
+}
+
+typedef struct {
+  sh_table *sh;
+  unsigned int id;
+  unsigned int mismatches;
+} sh_worker;
+
+/**
+ * Insert a range of keys of its own, reading each back, then delete every
+ * other key of the range.
+ */
+static void *sh_worker_run(void *arg) {
+  sh_worker *w = arg;
+  char key[32];
+
+  for (uintptr_t i = 0; i < SH_TEST_KEYS_PER_THREAD; i++) {
+    snprintf(key, sizeof(key), "t%u-%u", w->id, (unsigned int)i);
+    sh_insert(w->sh, key, (void *)(i + 1));
+
+    if (sh_get(w->sh, key) != (void *)(i + 1)) {
+      w->mismatches++;
+    }
+  }
+
+  for (unsigned int i = 0; i < SH_TEST_KEYS_PER_THREAD; i += 2) {
+    snprintf(key, sizeof(key), "t%u-%u", w->id, i);
+    if (sh_delete(w->sh, key) != 1) {
+      w->mismatches++;
+    }
+  }
+
+  return NULL;
+}
+
+static void test_sh_threads(void) {
+  hash_opts opts = {.shards = 4, .rehash_step = 8};
+  sh_table *sh = sh_init_opts(0, NULL, &opts);
+
+  pthread_t threads[SH_TEST_THREADS];
+  sh_worker workers[SH_TEST_THREADS];
+  for (unsigned int i = 0; i < SH_TEST_THREADS; i++) {
+    workers[i] = (sh_worker){.sh = sh, .id = i};
+    pthread_create(&threads[i], NULL, sh_worker_run, &workers[i]);
+  }
+
+  unsigned int mismatches = 0;
+  for (unsigned int i = 0; i < SH_TEST_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    mismatches += workers[i].mismatches;
+  }
+
+  ok(mismatches == 0, "every thread reads back what was inserted");
+  ok(sh_count(sh) == SH_TEST_THREADS * SH_TEST_KEYS_PER_THREAD / 2,
+     "retains exactly the entries no thread deleted");
+
+  sh_delete_table(sh);
+}
+
+void run_sh_table_tests(void) {
+  test_sh_initialization();
+  test_sh_insert();
+  test_sh_stats();
+  test_sh_steady_churn();
+  test_sh_delete_with_free();
+  test_sh_threads();
+}
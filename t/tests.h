@@ -3,9 +3,18 @@
 
 #include "libtap/libtap.h"
 
+void run_hash_tests(void);
+void run_group_tests(void);
 void run_hash_set_tests(void);
 void run_hash_table_tests(void);
+void run_rh_table_tests(void);
+void run_u64_table_tests(void);
+void run_ct_table_tests(void);
+void run_lf_table_tests(void);
+void run_sh_table_tests(void);
+void run_map_tests(void);
+void run_arena_tests(void);
+void run_alloc_tests(void);
 void run_prime_tests(void);
-void run_list_tests(void);
 
 #endif /* TESTS_H */
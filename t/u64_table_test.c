@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+static void test_u64_initialization(void) {
+  u64_table *ut = u64_init(10, NULL);
+
+  ok(ut != NULL, "integer-keyed table is not NULL");
+  ok(ut->capacity == HT_DEFAULT_CAPACITY, "clamps to the default capacity");
+  ok(ut->count == 0, "initial count is 0");
+
+  lives({ u64_delete_table(ut); }, "frees the integer-keyed table heap memory");
+}
+
+static void test_u64_insert(void) {
+  u64_table *ut = u64_init(0, NULL);
+
+  u64_insert(ut, 0, "v0");
+  u64_insert(ut, UINT64_MAX, "vmax");
+  ok(ut->count == 2, "increments the count when keys are inserted");
+  is(u64_get(ut, 0), "v0", "stores the zero key");
+  is(u64_get(ut, UINT64_MAX), "vmax", "stores the largest key");
+  ok(u64_search(ut, UINT64_MAX)->key == UINT64_MAX, "stores the key");
+
+  u64_insert(ut, 0, "v1");
+  ok(ut->count == 2, "does not increment the count when a key is updated");
+  is(u64_get(ut, 0), "v1", "updates the value");
+  ok(u64_search(ut, 1) == NULL, "returns NULL for a missing key");
+
+  u64_delete_table(ut);
+}
+
+static void test_u64_delete(void) {
+  u64_table *ut = u64_init(0, NULL);
+
+  u64_insert(ut, 1, "v1");
+  u64_insert(ut, 2, "v2");
+
+  ok(u64_delete(ut, 1) == 1, "returns 1 when the entry was deleted");
+  ok(u64_search(ut, 1) == NULL, "does not find the deleted key");
+  ok(u64_delete(ut, 1) == 0, "returns 0 when there is no such entry");
+  is(u64_get(ut, 2), "v2", "retains the remaining key");
+
+  const u64_entry *entries = ut->entries;
+  u64_delete(ut, 3);
+  ok(ut->entries == entries, "does not rebuild a table at its minimum size");
+
+  u64_delete_table(ut);
+}
+
+static void test_u64_update_full(void) {
+  u64_table *ut = u64_init(0, NULL);
+
+  uint64_t key = 0;
+  while (ut->count * 100 / ut->capacity <= 70) {
+    u64_insert(ut, key++, "x");
+  }
+
+  const u64_entry *entries = ut->entries;
+  u64_insert(ut, 0, "y");
+  ok(ut->entries == entries && u64_get(ut, 0) != NULL,
+     "updates a key in a table due to grow without growing it");
+
+  u64_insert(ut, key, "x");
+  ok(ut->entries != entries, "grows on the next new key");
+
+  u64_delete_table(ut);
+}
+
+static void test_u64_resize(void) {
+  hash_opts opts = {.pow2_capacity = true};
+  u64_table *ut = u64_init_opts(0, NULL, &opts);
+
+  // Keys that share their low bits, which the mixer must still spread out.
+  for (uint64_t i = 0; i < 2000; i++) {
+    u64_insert(ut, i << 32, (void *)(uintptr_t)(i + 1));
+  }
+
+  ok(ut->capacity > 2000, "grows the capacity");
+
+  unsigned int found = 0;
+  for (uint64_t i = 0; i < 2000; i++) {
+    found += u64_get(ut, i << 32) == (void *)(uintptr_t)(i + 1);
+  }
+  ok(found == 2000, "retains every entry across resizes");
+
+  unsigned int iterated = 0;
+  U64_ITER_START(ut)
+  iterated += (entry->key >> 32) + 1 == (uintptr_t)entry->value;
+  U64_ITER_END
+  ok(iterated == 2000, "iterates every entry");
+
+  for (uint64_t i = 0; i < 1990; i++) {
+    u64_delete(ut, i << 32);
+  }
+  ok(ut->capacity < 2000 && ut->count == 10, "shrinks as entries are deleted");
+
+  u64_delete_table(ut);
+}
+
+static void test_u64_churn(void) {
+  u64_table *ut = u64_init(0, NULL);
+
+  // Keep a steady 20 live keys while cycling through many more, so deleted
+  // markers pile up unless they are purged.
+  for (uint64_t i = 0; i < 5000; i++) {
+    u64_insert(ut, i, "x");
+
+    if (i >= 20) {
+      u64_delete(ut, i - 20);
+    }
+  }
+
+  unsigned int found = 0;
+  for (uint64_t i = 4980; i < 5000; i++) {
+    found += u64_search(ut, i) != NULL;
+  }
+
+  ok(ut->count == 20 && found == 20, "retains the live keys under churn");
+  ok(ut->capacity == HT_DEFAULT_CAPACITY &&
+         ut->deleted * 100 / ut->capacity < 70,
+     "purges deleted markers without growing");
+
+  u64_delete_table(ut);
+}
+
+static void test_u64_delete_with_free(void) {
+  u64_table *ut = u64_init(0, free);
+
+  u64_insert(ut, 1, strdup("v1"));
+  u64_insert(ut, 2, strdup("v2"));
+
+  u64_insert(ut, 2, strdup("v3"));
+  is(u64_get(ut, 2), "v3", "replaces the value, freeing the old one");
+
+  ok(u64_delete(ut, 1) == 1, "deletes an entry with a free function");
+  lives({ u64_delete_table(ut); }, "frees the remaining values");
+}
+
+void run_u64_table_tests(void) {
+  test_u64_initialization();
+  test_u64_insert();
+  test_u64_delete();
+  test_u64_update_full();
+  test_u64_resize();
+  test_u64_churn();
+  test_u64_delete_with_free();
+}